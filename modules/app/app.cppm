@@ -1,6 +1,8 @@
 module;
 #include <format>
 #include <array>
+#include <chrono>
+#include <optional>
 #include <vector>
 #include <memory>
 #include <functional>
@@ -42,10 +44,6 @@ import ce.vk.utils;
 import ce.shaders.solidflat;
 import ce.shaders.solidcolor;
 import glm;
-import :utils;
-import :frustum;
-import :chunkgen;
-import :chunkmesh;
 import :player;
 import :audio;
 import :server;
@@ -53,8 +51,61 @@ import :client;
 import :resources;
 import :world;
 import :systems;
-import :globals;
 import :shaders;
+import :governor;
+import :utils;
+import :globals;
+import :noise;
+import :frustum;
+import :chunkgen;
+import :chunkmesh;
+import :physics;
+import :messages;
+
+// The parts of the voxel pipeline ce.app.bench measures, the partitions stay internal
+export namespace ce::app
+{
+using ce::app::AABB;
+using ce::app::Frustum;
+using ce::app::BatchNoise;
+using ce::app::Block;
+using ce::app::BlockLayer;
+using ce::app::BlockLayerCount;
+using ce::app::BlockType;
+using ce::app::ChunkData;
+using ce::app::FlatGenerator;
+using ce::app::material;
+using ce::app::materials;
+using ce::app::ChunkMesher;
+using ce::app::BinaryMesher;
+using ce::app::GreedyMesher;
+using ce::app::LayerMeshes;
+using ce::app::MeshSlice;
+using ce::app::MeshSlices;
+using ce::app::face_key;
+using ce::app::pack_face;
+}
+export namespace ce::app::globals
+{
+using ce::app::globals::BlockSize;
+using ce::app::globals::ChunkSize;
+using ce::app::globals::MaxChunkRings;
+}
+export namespace ce::app::utils
+{
+using ce::app::utils::pow;
+using ce::app::utils::traverse_3d_dda;
+}
+export namespace ce::app::physics
+{
+using ce::app::physics::PhysicsSystem;
+}
+export namespace ce::app::messages
+{
+using ce::app::messages::BlockActionMessage;
+using ce::app::messages::ChunkDataMessage;
+using ce::app::messages::MessageDirection;
+}
 
 export namespace ce::app
 {
@@ -140,6 +191,12 @@ class AppBase final
     std::array<bool, 256> keys{false};
     uint32_t m_swapchain_count = 0;
     uint64_t m_timeline_value = 0;
+    governor::GpuTimer m_gpu_timer;
+    governor::RingGovernor m_ring_governor;
+    // main thread time of the frame, see govern_rings
+    std::chrono::steady_clock::time_point m_tick_start;
+    std::chrono::steady_clock::time_point m_update_start;
+    float m_cpu_ms = 0;
     ecs::Manager manager;
     entityx::EntityX ex;
 
@@ -150,6 +207,7 @@ public:
         {
             vkDeviceWaitIdle(m_vk->device());
         }
+        m_gpu_timer.destroy();
         // TODO: cleanup miniaudio
         m_world.destroy();
         systems::destroy_systems();
@@ -198,6 +256,10 @@ public:
                 "assets/grass.png", globals::m_resources->staging_buffer, {2, 4}).value();
             globals::m_resources->sampler = vk::texture::create_sampler(m_vk).value();
 
+            m_gpu_timer.create(m_vk, m_swapchain_count);
+            if (globals::frame_budget <= 0)
+                globals::frame_budget = 1000.f / (globals::xrmode ? 90.f : 60.f);
+
             m_vk->exec_immediate("init resources", [this](VkCommandBuffer cmd){
                 if (globals::xrmode)
                 {
@@ -220,6 +282,7 @@ public:
     void update(const float dt, const vk::utils::FrameContext& frame, const glm::mat4 view) noexcept
     {
         ZoneScoped;
+        m_update_start = std::chrono::steady_clock::now();
         shaders::reset_descriptors(frame.present_index);
         if (globals::server_mode)
         {
@@ -252,6 +315,9 @@ public:
     void render(const vk::utils::FrameContext& frame, const float dt, VkCommandBuffer cmd) noexcept
     {
         ZoneScoped;
+        // the slot's previous frame is done by the time it's recorded again
+        const std::optional<float> gpu_ms = m_gpu_timer.read(frame.present_index);
+        m_gpu_timer.begin(cmd, frame.present_index);
         {
             TracyVkZone(m_vk->tracy(), cmd, "Copy Buffers");
             globals::m_resources->exec_copy_buffers(cmd);
@@ -260,25 +326,60 @@ public:
         {
             TracyVkZone(m_vk->tracy(), cmd, "Copy Barrier");
             std::vector<VkBufferMemoryBarrier> barriers;
-            barriers.reserve(m_world.chunks_manager.m_chunks_state.size());
-            for (const auto& [k, state] : m_world.chunks_manager.m_chunks_state)
-            {
-                barriers.push_back({
-                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-                    .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                    .buffer = globals::m_resources->args_buffer.buffer(),
-                    .offset = state.args_buffer.offset,
-                    .size = state.args_buffer.size,
-                });
-            }
+            barriers.reserve(4);
+            // chunk records and the cull constants are read by the culling pass
+            barriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = globals::m_resources->cull_buffer.buffer(),
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+            });
+            barriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = globals::m_resources->frame_buffer.buffer(),
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+            });
+            // face records and chunk objects are read by the vertex shader
+            barriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = globals::m_resources->chunk_object_buffer.buffer(),
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+            });
+            barriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = globals::m_resources->face_buffer.buffer(),
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+            });
 
-            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
                 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
         }
 
+        {
+            TracyVkZone(m_vk->tracy(), cmd, "Chunk Culling");
+            m_world.cull(cmd);
+        }
+
         // char zone_name[64];
         // snprintf(zone_name, sizeof(zone_name), "RenderPass %llu", static_cast<uint64_t>(frame.timeline_value));
         // TracyVkZoneTransient(m_vk->tracy(), render_pass_zone, cmd, zone_name, true);
@@ -335,7 +436,29 @@ public:
         constexpr VkSubpassEndInfo subpass_end_info{.sType = VK_STRUCTURE_TYPE_SUBPASS_END_INFO};
         vkCmdEndRenderPass2(cmd, &subpass_end_info);
 
+        m_gpu_timer.end(cmd, frame.present_index);
         TracyVkCollect(m_vk->tracy(), cmd);
+        govern_rings(gpu_ms);
+    }
+    // Feeds the frame's cost to the ring governor, the chunks manager moves the edge of the
+    // ring on its next update. The CPU time leaves out the waits for the GPU and the display
+    // in between the tick and the update.
+    void govern_rings(const std::optional<float> gpu_ms) noexcept
+    {
+        using ms = std::chrono::duration<float, std::milli>;
+        m_cpu_ms += ms(std::chrono::steady_clock::now() - m_update_start).count();
+        if (!globals::ring_governor || globals::server_mode)
+            return;
+        auto& chunks = m_world.chunks_manager;
+        const auto stats = globals::m_resources->face_buffer.stats();
+        const VkDeviceSize capacity = stats.used + stats.free;
+        const governor::FrameSample sample{
+            .cpu_ms = m_cpu_ms,
+            .gpu_ms = gpu_ms,
+            .memory = capacity > 0 ? static_cast<float>(stats.used) / static_cast<float>(capacity) : 0.f,
+            .streaming = chunks.streaming(),
+        };
+        chunks.set_rings(m_ring_governor.update(sample, chunks.rings(), globals::frame_budget));
     }
     glm::mat4 update_flying_camera_angles(const float dt, const GamepadState& gamepad, const xr::TouchControllerState& touch)
     {
@@ -602,6 +725,7 @@ public:
     void tick(const float dt, const GamepadState& gamepad) noexcept
     {
         ZoneScoped;
+        m_tick_start = std::chrono::steady_clock::now();
         if (globals::server_mode)
         {
             systems::m_physics_system->tick(dt);
@@ -617,6 +741,7 @@ public:
         if (!globals::headless)
         {
             m_world.tick(dt);
+            m_cpu_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_tick_start).count();
             if (globals::xrmode)
             {
                 m_timeline_value = m_xr->timeline_value().value_or(0);
@@ -1,7 +1,14 @@
 module;
 #include <cstdint>
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <fstream>
+#include <optional>
+#include <span>
 #include <PerlinNoise.hpp>
+#include <shared_mutex>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -18,6 +25,7 @@ export module ce.app:chunkgen;
 import :utils;
 import glm;
 import :serializer;
+import :noise;
 
 export namespace ce::app
 {
@@ -26,6 +34,7 @@ enum class BlockLayer : uint8_t
     Transparent,
     Solid,
 };
+constexpr size_t BlockLayerCount = 2;
 const char* to_string(const BlockLayer b)
 {
     switch (b)
@@ -63,15 +72,20 @@ struct BlockMaterial
     BlockLayer layer;
     std::array<glm::uvec2, 6> uvs;
 };
-// Face order: U, D, F, B, R, L
-const std::unordered_map<BlockType, BlockMaterial> materials {
-    {BlockType::Air, {BlockLayer::Transparent, std::to_array<glm::uvec2>({{0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0}})}},
-    {BlockType::Grass, {BlockLayer::Solid, std::to_array<glm::uvec2>({{1, 0}, {1, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}})}},
-    {BlockType::Dirt, {BlockLayer::Solid, std::to_array<glm::uvec2>({{1, 1}, {1, 1}, {1, 1}, {1, 1}, {1, 1}, {1, 1}})}},
-    {BlockType::Sand, {BlockLayer::Solid, std::to_array<glm::uvec2>({{0, 2}, {0, 2}, {0, 2}, {0, 2}, {0, 2}, {0, 2}})}},
-    {BlockType::Rock, {BlockLayer::Solid, std::to_array<glm::uvec2>({{1, 2},{1, 2},{1, 2},{1, 2},{1, 2},{1, 2}})}},
-    {BlockType::Water, {BlockLayer::Transparent, std::to_array<glm::uvec2>({{0, 1}, {0, 1}, {0, 1}, {0, 1}, {0, 1}, {0, 1}})}},
-};
+// Indexed by BlockType. Face order: U, D, F, B, R, L
+constexpr auto materials = std::to_array<BlockMaterial>({
+    /* Air   */ {BlockLayer::Transparent, std::to_array<glm::uvec2>({{0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0}})},
+    /* Water */ {BlockLayer::Transparent, std::to_array<glm::uvec2>({{0, 1}, {0, 1}, {0, 1}, {0, 1}, {0, 1}, {0, 1}})},
+    /* Grass */ {BlockLayer::Solid, std::to_array<glm::uvec2>({{1, 0}, {1, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}})},
+    /* Dirt  */ {BlockLayer::Solid, std::to_array<glm::uvec2>({{1, 1}, {1, 1}, {1, 1}, {1, 1}, {1, 1}, {1, 1}})},
+    /* Sand  */ {BlockLayer::Solid, std::to_array<glm::uvec2>({{0, 2}, {0, 2}, {0, 2}, {0, 2}, {0, 2}, {0, 2}})},
+    /* Rock  */ {BlockLayer::Solid, std::to_array<glm::uvec2>({{1, 2},{1, 2},{1, 2},{1, 2},{1, 2},{1, 2}})},
+});
+static_assert(materials.size() == static_cast<size_t>(BlockType::Rock) + 1, "one material per BlockType");
+[[nodiscard]] constexpr const BlockMaterial& material(const BlockType type) noexcept
+{
+    return materials[static_cast<size_t>(type)];
+}
 
 struct Block final
 {
@@ -80,11 +94,16 @@ struct Block final
     enum class Mask : uint8_t { U = 1, D = 2, F = 4, B = 8, L = 16, R = 32 };
     // Bits mask using Block::Mask enum
     uint8_t face_mask = 0;
+    // Non zero when the block touches water
     uint8_t water_mask = 0;
-    int32_t water_depth = 0;
 };
+// Voxels of a chunk: a palette of the block types in use with bit packed indices,
+// plus one bit plane per face and one for water contacts. Every plane stores a
+// row of x bits per (y, z), blocks are indexed by x + z * size + y * size * size.
 struct ChunkData final
 {
+    // a plane row is a single uint32_t
+    static constexpr uint32_t MaxSize = 32;
     ChunkData() = default;
     ChunkData(const ChunkData& other) = delete;
     ChunkData(ChunkData&& other) noexcept = default;
@@ -92,10 +111,140 @@ struct ChunkData final
     ChunkData& operator=(ChunkData&& other) noexcept = default;
     uint32_t size{0};
     glm::ivec3 sector{0};
-    std::vector<Block> blocks;
     bool empty = true;
-};
+    // Buried chunk with no exposed face: nothing to mesh or collide with,
+    // the block types are not stored
+    bool solid = false;
+    std::vector<BlockType> palette{BlockType::Air};
+    // 0, 1, 2 or 4 bits per index so an index never straddles two words
+    uint32_t bits = 0;
+    std::vector<uint64_t> indices;
+    std::array<std::vector<uint32_t>, 6> faces;
+    std::vector<uint32_t> water;
 
+    void resize(const uint32_t chunk_size) noexcept
+    {
+        size = chunk_size;
+        for (auto& plane : faces)
+            plane.assign(chunk_size * chunk_size, 0);
+        water.assign(chunk_size * chunk_size, 0);
+    }
+    // Replaces all the block types, types must hold size^3 entries
+    void assign(const std::vector<BlockType>& types) noexcept
+    {
+        palette.clear();
+        for (const BlockType t : types)
+        {
+            if (std::ranges::find(palette, t) == palette.end())
+                palette.push_back(t);
+        }
+        if (palette.empty())
+            palette.push_back(BlockType::Air);
+        pack(types, bits_for(palette.size()));
+    }
+    [[nodiscard]] BlockType type(const uint32_t idx) const noexcept
+    {
+        if (bits == 0)
+            return palette[0];
+        const uint32_t per_word = 64 / bits;
+        const uint64_t word = indices[idx / per_word];
+        return palette[(word >> ((idx % per_word) * bits)) & ((1ull << bits) - 1)];
+    }
+    [[nodiscard]] BlockType type(const glm::uvec3& cell) const noexcept
+    {
+        return type(cell.x + cell.z * size + cell.y * size * size);
+    }
+    void set_type(const uint32_t idx, const BlockType t) noexcept
+    {
+        auto it = std::ranges::find(palette, t);
+        if (it == palette.end())
+        {
+            palette.push_back(t);
+            it = palette.end() - 1;
+            if (const uint32_t new_bits = bits_for(palette.size()); new_bits != bits)
+            {
+                std::vector<BlockType> types(utils::pow(size, 3));
+                for (uint32_t i = 0; i < types.size(); ++i)
+                    types[i] = type(i);
+                pack(types, new_bits);
+            }
+        }
+        if (bits == 0)
+            return;
+        const uint32_t per_word = 64 / bits;
+        const uint32_t shift = (idx % per_word) * bits;
+        const uint64_t mask = ((1ull << bits) - 1) << shift;
+        uint64_t& word = indices[idx / per_word];
+        word = (word & ~mask) | (static_cast<uint64_t>(it - palette.begin()) << shift);
+    }
+    [[nodiscard]] bool face(const uint32_t face_index, const uint32_t idx) const noexcept
+    {
+        return (faces[face_index][idx / size] >> (idx % size)) & 1;
+    }
+    [[nodiscard]] uint8_t face_mask(const uint32_t idx) const noexcept
+    {
+        uint8_t mask = 0;
+        for (uint32_t f = 0; f < faces.size(); ++f)
+            mask |= face(f, idx) << f;
+        return mask;
+    }
+    void set_face_mask(const uint32_t idx, const uint8_t mask) noexcept
+    {
+        for (uint32_t f = 0; f < faces.size(); ++f)
+            set_bit(faces[f], idx, (mask >> f) & 1);
+    }
+    [[nodiscard]] bool touches_water(const uint32_t idx) const noexcept
+    {
+        return (water[idx / size] >> (idx % size)) & 1;
+    }
+    void set_touches_water(const uint32_t idx, const bool value) noexcept
+    {
+        set_bit(water, idx, value);
+    }
+    [[nodiscard]] Block block(const uint32_t idx) const noexcept
+    {
+        return {type(idx), face_mask(idx), static_cast<uint8_t>(touches_water(idx))};
+    }
+    [[nodiscard]] size_t memory_bytes() const noexcept
+    {
+        size_t bytes = palette.capacity() * sizeof(BlockType) + indices.capacity() * sizeof(uint64_t) +
+            water.capacity() * sizeof(uint32_t);
+        for (const auto& plane : faces)
+            bytes += plane.capacity() * sizeof(uint32_t);
+        return bytes;
+    }
+private:
+    [[nodiscard]] static uint32_t bits_for(const size_t palette_size) noexcept
+    {
+        if (palette_size <= 1)
+            return 0;
+        if (palette_size <= 2)
+            return 1;
+        if (palette_size <= 4)
+            return 2;
+        return 4;
+    }
+    void pack(const std::vector<BlockType>& types, const uint32_t new_bits) noexcept
+    {
+        bits = new_bits;
+        indices.clear();
+        if (bits == 0)
+            return;
+        const uint32_t per_word = 64 / bits;
+        indices.assign((types.size() + per_word - 1) / per_word, 0);
+        for (uint32_t i = 0; i < types.size(); ++i)
+        {
+            const uint64_t p = std::ranges::find(palette, types[i]) - palette.begin();
+            indices[i / per_word] |= p << ((i % per_word) * bits);
+        }
+    }
+    void set_bit(std::vector<uint32_t>& plane, const uint32_t idx, const bool value) const noexcept
+    {
+        const uint32_t bit = 1u << (idx % size);
+        plane[idx / size] = value ? plane[idx / size] | bit : plane[idx / size] & ~bit;
+    }
+};
+static_assert(static_cast<size_t>(BlockType::Rock) < 16, "palette indices are at most 4 bits");
 struct IVec3Hash
 {
     size_t operator()(const glm::ivec3& v) const noexcept
@@ -127,6 +276,97 @@ struct U8Vec3Hash
     }
 };
 
+// Edited cells of a single sector in an open addressing table keyed by the packed
+// local cell, keys and block types in two flat arrays. Edits are overwritten but
+// never erased, so the linear probing needs no tombstones.
+class SectorEdits
+{
+    static constexpr uint32_t EmptyKey = 0xFFFFFFFF;
+    std::vector<uint32_t> m_keys;
+    std::vector<BlockType> m_values;
+    uint32_t m_size = 0;
+    uint32_t m_shift = 32;
+
+    [[nodiscard]] static uint32_t pack(const glm::u8vec3& cell) noexcept
+    {
+        return uint32_t(cell.x) | (uint32_t(cell.y) << 8) | (uint32_t(cell.z) << 16);
+    }
+    [[nodiscard]] static glm::u8vec3 unpack(const uint32_t key) noexcept
+    {
+        return {static_cast<uint8_t>(key), static_cast<uint8_t>(key >> 8), static_cast<uint8_t>(key >> 16)};
+    }
+    [[nodiscard]] size_t probe(const uint32_t key) const noexcept
+    {
+        // fibonacci hashing, the packed coordinates alone cluster in the low bits
+        const size_t mask = m_keys.size() - 1;
+        size_t i = (key * 2654435769u) >> m_shift;
+        while (m_keys[i] != key && m_keys[i] != EmptyKey)
+            i = (i + 1) & mask;
+        return i;
+    }
+    void grow() noexcept
+    {
+        const size_t capacity = m_keys.empty() ? 16 : m_keys.size() * 2;
+        std::vector<uint32_t> keys(capacity, EmptyKey);
+        std::vector<BlockType> values(capacity);
+        std::swap(keys, m_keys);
+        std::swap(values, m_values);
+        m_shift = 32 - std::countr_zero(capacity);
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            if (keys[i] == EmptyKey)
+                continue;
+            const size_t slot = probe(keys[i]);
+            m_keys[slot] = keys[i];
+            m_values[slot] = values[i];
+        }
+    }
+public:
+    [[nodiscard]] size_t size() const noexcept { return m_size; }
+    [[nodiscard]] bool empty() const noexcept { return m_size == 0; }
+    [[nodiscard]] std::optional<BlockType> find(const glm::u8vec3& cell) const noexcept
+    {
+        if (m_size == 0)
+            return std::nullopt;
+        const size_t i = probe(pack(cell));
+        if (m_keys[i] == EmptyKey)
+            return std::nullopt;
+        return m_values[i];
+    }
+    void set(const glm::u8vec3& cell, const BlockType type) noexcept
+    {
+        // keep the load factor under 3/4
+        if ((m_size + 1) * 4 > m_keys.size() * 3)
+            grow();
+        const uint32_t key = pack(cell);
+        const size_t i = probe(key);
+        if (m_keys[i] == EmptyKey)
+        {
+            m_keys[i] = key;
+            m_size++;
+        }
+        m_values[i] = type;
+    }
+    void clear() noexcept
+    {
+        std::ranges::fill(m_keys, EmptyKey);
+        m_size = 0;
+    }
+    template<typename F>
+    void for_each(F&& fn) const noexcept
+    {
+        for (size_t i = 0; i < m_keys.size(); ++i)
+        {
+            if (m_keys[i] != EmptyKey)
+                fn(unpack(m_keys[i]), m_values[i]);
+        }
+    }
+    [[nodiscard]] size_t memory_bytes() const noexcept
+    {
+        return m_keys.capacity() * sizeof(uint32_t) + m_values.capacity() * sizeof(BlockType);
+    }
+};
+
 class ChunkGenerator
 {
 public:
@@ -140,7 +380,11 @@ class FlatGenerator final : public ChunkGenerator
     uint32_t m_memory_size_bytes = 0;
 	// siv::PerlinNoise perlin{ std::random_device{} };
 	siv::PerlinNoise perlin{ 1 };
-    std::unordered_map<glm::ivec3, std::unordered_map<glm::u8vec3, BlockType, U8Vec3Hash>, IVec3Hash> m_edits;
+    // same permutation as perlin, generate() samples whole rows with it and peek() single cells
+    BatchNoise m_noise{ perlin.serialize() };
+    std::unordered_map<glm::ivec3, SectorEdits, IVec3Hash> m_edits;
+    // generate() runs on the worker threads while edits come from the main thread
+    mutable std::shared_mutex m_edits_mutex;
     // std::unordered_map<glm::ivec3, bool, IVec3Hash> m_net_ready;
     bool m_dirty = false;
     std::unordered_map<glm::ivec3, std::vector<BlockType>, IVec3Hash> m_blocks;
@@ -149,73 +393,130 @@ public:
     explicit FlatGenerator(const uint32_t size, const uint32_t ground_height) noexcept
         : m_chunk_size(size), m_ground_height(ground_height) { }
     [[nodiscard]] BlockType peek(const glm::ivec3 cell) const noexcept
+    {
+        std::shared_lock lock(m_edits_mutex);
+        return peek_unlocked(cell);
+    }
+    [[nodiscard]] BlockType peek_unlocked(const glm::ivec3 cell) const noexcept
+    {
+        if (const auto edit = find_edit(cell))
+            return *edit;
+        const glm::vec3 nc = glm::vec3(cell) / static_cast<float>(m_chunk_size);
+        const float rand = m_noise.noise2D_01(nc.x * 10.f, nc.y * 10.f);
+        const float mountains = m_noise.noise2D_01(nc.x * 0.1f, nc.y * 0.1f);
+        return classify(cell.y, terrain_height(m_noise.octave2D(nc.x, nc.z, 4), mountains), rand);
+    }
+    [[nodiscard]] std::optional<BlockType> find_edit(const glm::ivec3 cell) const noexcept
     {
         const int32_t ssz = static_cast<int32_t>(m_chunk_size);
         const glm::ivec3 sector = glm::floor(glm::vec3(cell) / ssz);
         const glm::u8vec3 local_cell = cell - sector * ssz;
-        const auto sector_it =  m_edits.find(sector);
-        if (sector_it != m_edits.end())
-        {
-            const auto cell_it = sector_it->second.find(local_cell);
-            if (cell_it != sector_it->second.end())
-            {
-                return cell_it->second;
-            }
-        }
-        const glm::vec3 nc = glm::vec3(cell) / static_cast<float>(ssz);
-        const float rand = perlin.noise2D_01(nc.x * 10.f, nc.y * 10.f);
-        const float mountains = perlin.noise2D_01(nc.x * 0.1f, nc.y * 0.1f);
-        const int32_t terrain_height = std::floor(perlin.octave2D(nc.x, nc.z, 4) * static_cast<float>(m_ground_height) + (mountains * 5.f));
+        if (const auto it = m_edits.find(sector); it != m_edits.end())
+            return it->second.find(local_cell);
+        return std::nullopt;
+    }
+    [[nodiscard]] int32_t terrain_height(const double octave, const float mountains) const noexcept
+    {
+        return std::floor(octave * static_cast<float>(m_ground_height) + (mountains * 5.f));
+    }
+    [[nodiscard]] BlockType classify(const int32_t y, const int32_t terrain_height, const float rand) const noexcept
+    {
         BlockType block = BlockType::Air;
-        if (cell.y < 0)
+        if (y < 0)
         {
             block = BlockType::Water;
-            if (cell.y <= terrain_height)
+            if (y <= terrain_height)
                 block = BlockType::Sand;
-            if (cell.y < (terrain_height - 3))
+            if (y < (terrain_height - 3))
                 block = BlockType::Rock;
         }
         else
         {
-            if (cell.y <= terrain_height)
+            if (y <= terrain_height)
             {
                 block = BlockType::Grass;
-                if (cell.y > m_ground_height / 2 && rand < 0.5f)
+                if (y > static_cast<int32_t>(m_ground_height / 2) && rand < 0.5f)
                     block = BlockType::Rock;
             }
-            if (cell.y < (terrain_height - 1))
+            if (y < (terrain_height - 1))
                 block = BlockType::Dirt;
         }
         return block;
     }
+    // Face and water masks of a block from its neighbours in Block::FaceIndex order
+    [[nodiscard]] static Block make_block(const BlockType C, const std::array<BlockType, 6>& neighbours) noexcept
+    {
+        Block block{C};
+        if (C == BlockType::Air)
+            return block;
+        const auto C_layer = material(C).layer;
+        for (uint32_t f = 0; f < neighbours.size(); ++f)
+        {
+            // water only shows its faces against air, other blocks against a different layer
+            const bool visible = C == BlockType::Water ? neighbours[f] == BlockType::Air :
+                C_layer != material(neighbours[f]).layer;
+            block.face_mask |= visible << f;
+            block.water_mask |= (neighbours[f] == BlockType::Water) << f;
+        }
+        return block;
+    }
+    [[nodiscard]] static BlockType majority(const std::array<int32_t, 6>& counts, const int32_t total) noexcept
+    {
+        const int32_t air = counts[static_cast<size_t>(BlockType::Air)];
+        if (air * 2 > total)
+            return BlockType::Air;
+        BlockType block = BlockType::Air;
+        int32_t best = 0;
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            if (static_cast<BlockType>(i) != BlockType::Air && counts[i] > best)
+            {
+                best = counts[i];
+                block = static_cast<BlockType>(i);
+            }
+        }
+        return block;
+    }
     [[nodiscard]] std::vector<uint8_t> serialize(const glm::ivec3& sector) const noexcept
     {
+        std::shared_lock lock(m_edits_mutex);
         serializer::MessageWriter w;
         if (const auto it = m_edits.find(sector); it != m_edits.end())
         {
             const auto& map = it->second;
             w.write<uint16_t>(map.size());
-            for (const auto& [cell, block] : map)
+            map.for_each([&w](const glm::u8vec3& cell, const BlockType block)
             {
                 w.write(cell);
                 w.write(block);
-            }
+            });
         }
         return std::move(w.buffer);
     }
+    // Replaces the edits of the sector with the server's, a sector without any is dropped
+    // so generation goes back to the plain terrain path for it
     void deserialize_apply(const glm::ivec3& sector, const std::vector<uint8_t>& data) noexcept
     {
+        std::unique_lock lock(m_edits_mutex);
         if (data.empty())
+        {
+            m_edits.erase(sector);
             return;
+        }
         serializer::MessageReader r(data);
+        const auto size = r.read<uint16_t>();
+        if (size == 0)
+        {
+            m_edits.erase(sector);
+            return;
+        }
         auto& map = m_edits[sector];
         map.clear();
-        const auto size = r.read<uint16_t>();
         for (uint16_t i = 0; i < size; i++)
         {
             const auto cell = r.read<glm::u8vec3>();
             const auto block = r.read<BlockType>();
-            map[cell] = block;
+            map.set(cell, block);
         }
     }
     // [[nodiscard]] bool is_net_ready(const glm::ivec3& sector) const noexcept
@@ -230,7 +531,8 @@ public:
     // }
     void edit(const glm::ivec3& sector, const glm::u8vec3& local_cell, const BlockType block_type) noexcept
     {
-        m_edits[sector][local_cell] = block_type;
+        std::unique_lock lock(m_edits_mutex);
+        m_edits[sector].set(local_cell, block_type);
         m_dirty = true;
     }
     void remove(const glm::ivec3& sector, const glm::u8vec3& local_cell) noexcept
@@ -238,15 +540,16 @@ public:
         const auto neighbours = std::to_array<glm::ivec3>({
             {-1, 0, 0}, {+1, 0, 0}, {0, +1, 0}, {0, 0, -1}, {0, 0, +1},
         });
+        std::unique_lock lock(m_edits_mutex);
         // water floods into blocks that are next to other water blocks
         if (std::ranges::any_of(neighbours, [this, cell=sector*static_cast<int32_t>(m_chunk_size)+glm::ivec3(local_cell)](const glm::ivec3& offset)
-            { return peek(cell+offset) == BlockType::Water; }))
+            { return peek_unlocked(cell+offset) == BlockType::Water; }))
         {
-            m_edits[sector][local_cell] = BlockType::Water;
+            m_edits[sector].set(local_cell, BlockType::Water);
         }
         else
         {
-            m_edits[sector][local_cell] = BlockType::Air;
+            m_edits[sector].set(local_cell, BlockType::Air);
         }
         m_dirty = true;
     }
@@ -257,6 +560,7 @@ public:
     }
     void save() noexcept
     {
+        std::unique_lock lock(m_edits_mutex);
         if (!m_dirty)
             return;
         std::ofstream file("terrain.bin", std::ios::binary);
@@ -267,11 +571,11 @@ public:
         {
             write(file, sector);
             write(file, cells.size());
-            for (const auto& [cell, type] : cells)
+            cells.for_each([this, &file](const glm::u8vec3& cell, const BlockType type)
             {
                 write(file, cell);
                 write(file, type);
-            }
+            });
         }
         m_dirty = false;
         LOGI("terrain saved");
@@ -288,6 +592,7 @@ public:
         std::ifstream file("terrain.bin", std::ios::binary);
         if (!file.is_open())
             return;
+        std::unique_lock lock(m_edits_mutex);
         for (auto i = read<size_t>(file); i > 0 ; --i)
         {
             const auto sector = read<glm::ivec3>(file);
@@ -295,15 +600,99 @@ public:
             {
                 const auto cell = read<glm::u8vec3>(file);
                 const auto type = read<BlockType>(file);
-                m_edits[sector][cell] = type;
+                m_edits[sector].set(cell, type);
             }
         }
     }
     [[nodiscard]] ChunkData generate(const glm::ivec3& sector, const uint32_t lod) const noexcept override
     {
+        std::shared_lock lock(m_edits_mutex);
+        const int32_t ilod = static_cast<int32_t>(lod);
         const int32_t ssz = static_cast<int32_t>(m_chunk_size / lod);
+        const int32_t sz = ssz + 2;
+        // fine cells per padded axis, a lod cell covers lod^3 of them
+        const int32_t fsz = sz * ilod;
+        const glm::ivec3 origin = sector * ssz * ilod;
+
+        // the padding reaches into the neighbours, only look up edits if any of them has some
+        bool has_edits = false;
+        for (int32_t y = -1; y <= 1 && !has_edits; ++y)
+            for (int32_t z = -1; z <= 1 && !has_edits; ++z)
+                for (int32_t x = -1; x <= 1 && !has_edits; ++x)
+                    has_edits = m_edits.contains(sector + glm::ivec3(x, y, z));
+
+        // The noise terms only depend on two coordinates each: the octave on (x, z),
+        // the mountains and rock mask on (x, y). Sample them once per padded row of
+        // fine cells with the batch kernel instead of once per voxel, the results match peek().
+        std::vector<double> octaves(utils::pow(fsz, 2));
+        std::vector<double> mountains(utils::pow(fsz, 2));
+        std::vector<double> rocks(utils::pow(fsz, 2));
+        std::vector<double> row_x(fsz), row_y(fsz);
+        const auto sample_rows = [&](std::vector<double>& table, const float scale, const int32_t other_comp, const bool octave)
+        {
+            for (int32_t j = -ilod; j < (ssz + 1) * ilod; ++j)
+            {
+                for (int32_t i = -ilod; i < (ssz + 1) * ilod; ++i)
+                {
+                    const glm::vec3 nc = glm::vec3(glm::ivec3(i, j, j) + origin) / static_cast<float>(m_chunk_size);
+                    row_x[i + ilod] = nc.x * scale;
+                    row_y[i + ilod] = nc[other_comp] * scale;
+                }
+                const auto row = std::span(table).subspan((j + ilod) * fsz, fsz);
+                if (octave)
+                    m_noise.octave2D(row_x, row_y, row, 4);
+                else
+                    m_noise.noise2D_01(row_x, row_y, row);
+            }
+        };
+        sample_rows(octaves, 1.f, 2, true);
+        sample_rows(mountains, 0.1f, 1, false);
+
+        // The height is monotonic in both terms, so their extremes over the padded
+        // volume bound every column. Chunks entirely above ground are empty, chunks
+        // buried down to their padding have no visible face. Edits can carve or
+        // fill anything so they always take the full path.
+        if (!has_edits)
+        {
+            const auto [min_octave, max_octave] = std::ranges::minmax(octaves);
+            const auto [min_mountains, max_mountains] = std::ranges::minmax(mountains);
+            const int32_t min_height = terrain_height(min_octave, min_mountains);
+            const int32_t max_height = terrain_height(max_octave, max_mountains);
+            if (origin.y >= 0 && origin.y > max_height)
+            {
+                ChunkData ret;
+                ret.size = ssz;
+                ret.sector = sector;
+                return ret;
+            }
+            if (origin.y + (ssz + 1) * ilod - 1 <= min_height)
+            {
+                ChunkData ret;
+                ret.size = ssz;
+                ret.sector = sector;
+                ret.empty = false;
+                ret.solid = true;
+                return ret;
+            }
+        }
+        sample_rows(rocks, 10.f, 1, false);
+
+        // fine is relative to the chunk origin and starts at -lod
+        const auto sample = [&](const glm::ivec3& fine)
+        {
+            const glm::ivec3 cell = fine + origin;
+            if (has_edits)
+            {
+                if (const auto edit = find_edit(cell))
+                    return *edit;
+            }
+            const int32_t height = terrain_height(octaves[(fine.z + ilod) * fsz + fine.x + ilod],
+                mountains[(fine.y + ilod) * fsz + fine.x + ilod]);
+            return classify(cell.y, height, rocks[(fine.y + ilod) * fsz + fine.x + ilod]);
+        };
+
         std::vector<BlockType> tmp;
-        tmp.reserve(utils::pow(ssz + 2, 3));
+        tmp.reserve(utils::pow(sz, 3));
         for (int32_t y = -1; y < ssz + 1; ++y)
         {
             for (int32_t z = -1; z < ssz + 1; ++z)
@@ -311,66 +700,84 @@ public:
                 for (int32_t x = -1; x < ssz + 1; ++x)
                 {
                     const glm::ivec3 loc{x, y, z};
-                    const glm::ivec3 cell = loc * glm::ivec3(lod) + sector * ssz * static_cast<int32_t>(lod);
-                    tmp.emplace_back(peek(cell));
+                    if (lod == 1)
+                    {
+                        tmp.emplace_back(sample(loc));
+                        continue;
+                    }
+                    // Downsample by majority: the lod cell is solid if at least half of its fine
+                    // cells are, and takes the most common of their materials. Point sampling
+                    // would erase thin layers and punch holes in the surface.
+                    std::array<int32_t, 6> counts{};
+                    for (int32_t dy = 0; dy < ilod; ++dy)
+                        for (int32_t dz = 0; dz < ilod; ++dz)
+                            for (int32_t dx = 0; dx < ilod; ++dx)
+                                counts[static_cast<size_t>(sample(loc * ilod + glm::ivec3(dx, dy, dz)))]++;
+                    tmp.emplace_back(majority(counts, utils::pow(ilod, 3)));
                 }
             }
         }
 
         bool full = false;
-        std::vector<Block> blocks;
-        blocks.reserve(utils::pow(ssz, 3));
+        ChunkData ret;
+        ret.sector = sector;
+        std::vector<BlockType> types;
+        types.reserve(utils::pow(ssz, 3));
         for (uint32_t y = 0; y < m_chunk_size / lod; ++y)
         {
             for (uint32_t z = 0; z < m_chunk_size / lod; ++z)
             {
                 for (uint32_t x = 0; x < m_chunk_size / lod; ++x)
                 {
-                    const int32_t sz = static_cast<int32_t>(m_chunk_size / lod + 2);
                     const auto C = tmp[(y + 1) * utils::pow(sz, 2) + (z + 1) * sz + x + 1];
-                    uint8_t mask = 0;
-                    uint8_t water_mask = 0;
-                    if (C != BlockType::Air)
+                    types.push_back(C);
+                    full |= C != BlockType::Air;
+                }
+            }
+        }
+        ret.size = m_chunk_size / lod;
+        ret.empty = !full;
+        if (!full)
+            return ret;
+
+        ret.resize(m_chunk_size / lod);
+        ret.assign(types);
+        for (uint32_t y = 0; y < m_chunk_size / lod; ++y)
+        {
+            for (uint32_t z = 0; z < m_chunk_size / lod; ++z)
+            {
+                for (uint32_t x = 0; x < m_chunk_size / lod; ++x)
+                {
+                    const auto at = [&](const int32_t dx, const int32_t dy, const int32_t dz)
                     {
-                        const auto C_layer = materials.at(C).layer;
-                        if (C == BlockType::Water)
-                        {
-                            mask |= (tmp[(y + 2) * utils::pow(sz, 2) + (z + 1) * sz + x + 1] == BlockType::Air) << 0;
-                            mask |= (tmp[(y + 0) * utils::pow(sz, 2) + (z + 1) * sz + x + 1] == BlockType::Air) << 1;
-                            mask |= (tmp[(y + 1) * utils::pow(sz, 2) + (z + 2) * sz + x + 1] == BlockType::Air) << 2;
-                            mask |= (tmp[(y + 1) * utils::pow(sz, 2) + (z + 0) * sz + x + 1] == BlockType::Air) << 3;
-                            mask |= (tmp[(y + 1) * utils::pow(sz, 2) + (z + 1) * sz + x + 0] == BlockType::Air) << 4;
-                            mask |= (tmp[(y + 1) * utils::pow(sz, 2) + (z + 1) * sz + x + 2] == BlockType::Air) << 5;
-                        }
-                        else
+                        return tmp[(y + 1 + dy) * utils::pow(sz, 2) + (z + 1 + dz) * sz + x + 1 + dx];
+                    };
+                    const auto C = at(0, 0, 0);
+                    auto [type, mask, water_mask] = make_block(C,
+                        {at(0, 1, 0), at(0, -1, 0), at(0, 0, 1), at(0, 0, -1), at(-1, 0, 0), at(1, 0, 0)});
+                    // Skirts: a lod chunk doesn't know the resolution of its neighbours, so the
+                    // side faces on its border near the surface are always emitted to cover
+                    // the cracks against finer or coarser terrain.
+                    if (lod > 1 && C != BlockType::Air && C != BlockType::Water)
+                    {
+                        const bool surface = at(0, 1, 0) == BlockType::Air ||
+                            (static_cast<int32_t>(y) + 3 < sz && at(0, 2, 0) == BlockType::Air);
+                        if (surface)
                         {
-                            auto is_visible = [C_layer](const BlockType b){ return C_layer != materials.at(b).layer; };
-                            mask |= is_visible(tmp[(y + 2) * utils::pow(sz, 2) + (z + 1) * sz + x + 1]) << 0;
-                            mask |= is_visible(tmp[(y + 0) * utils::pow(sz, 2) + (z + 1) * sz + x + 1]) << 1;
-                            mask |= is_visible(tmp[(y + 1) * utils::pow(sz, 2) + (z + 2) * sz + x + 1]) << 2;
-                            mask |= is_visible(tmp[(y + 1) * utils::pow(sz, 2) + (z + 0) * sz + x + 1]) << 3;
-                            mask |= is_visible(tmp[(y + 1) * utils::pow(sz, 2) + (z + 1) * sz + x + 0]) << 4;
-                            mask |= is_visible(tmp[(y + 1) * utils::pow(sz, 2) + (z + 1) * sz + x + 2]) << 5;
+                            const uint32_t edge = m_chunk_size / lod - 1;
+                            mask |= (z == edge) << 2;
+                            mask |= (z == 0) << 3;
+                            mask |= (x == 0) << 4;
+                            mask |= (x == edge) << 5;
                         }
-                        water_mask |= (tmp[(y + 2) * utils::pow(sz, 2) + (z + 1) * sz + x + 1] == BlockType::Water) << 0;
-                        water_mask |= (tmp[(y + 0) * utils::pow(sz, 2) + (z + 1) * sz + x + 1] == BlockType::Water) << 1;
-                        water_mask |= (tmp[(y + 1) * utils::pow(sz, 2) + (z + 2) * sz + x + 1] == BlockType::Water) << 2;
-                        water_mask |= (tmp[(y + 1) * utils::pow(sz, 2) + (z + 0) * sz + x + 1] == BlockType::Water) << 3;
-                        water_mask |= (tmp[(y + 1) * utils::pow(sz, 2) + (z + 1) * sz + x + 0] == BlockType::Water) << 4;
-                        water_mask |= (tmp[(y + 1) * utils::pow(sz, 2) + (z + 1) * sz + x + 2] == BlockType::Water) << 5;
                     }
-                    // const BlockType type = mask == 0 ? BlockType::Air : C;
-                    blocks.emplace_back(C, mask, water_mask);
-                    full |= C != BlockType::Air;
+                    const uint32_t row = y * ret.size + z;
+                    for (uint32_t f = 0; f < ret.faces.size(); ++f)
+                        ret.faces[f][row] |= ((mask >> f) & 1u) << x;
+                    ret.water[row] |= static_cast<uint32_t>(water_mask != 0) << x;
                 }
             }
         }
-
-        ChunkData ret;
-        ret.size = m_chunk_size / lod;
-        ret.sector = sector;
-        ret.blocks = std::move(blocks);
-        ret.empty = !full;
         return ret;
     }
 };
@@ -7,6 +7,10 @@ module;
 #include <span>
 #include <array>
 #include <unordered_map>
+#include <algorithm>
+#include <bit>
+#include <utility>
+#include <mutex>
 #include <volk.h>
 
 #include <Jolt/Jolt.h>
@@ -42,162 +46,475 @@ concept VertexType = requires(T t)
 template<typename T>
 struct ChunkMesh final
 {
-    using VertexType = T;
-    std::vector<VertexType> vertices;
+    using FaceType = T;
+    // one record per quad, the vertex shader expands it to 6 vertices;
+    // grouped by direction in MeshSlices order so each one can be drawn on its own
+    std::vector<FaceType> faces;
+    std::array<uint32_t, 6> direction_count{};
 };
+// Mesher output indexed by BlockLayer
+template<typename T>
+using LayerMeshes = std::array<ChunkMesh<T>, BlockLayerCount>;
 template<typename T>
 class ChunkMesher
 {
 public:
     virtual ~ChunkMesher() = default;
-    [[nodiscard]] virtual std::unordered_map<BlockLayer, ChunkMesh<T>> mesh(
-        const ChunkData& data, const float block_size, const uint32_t lod) const noexcept = 0;
+    // Overwrites out, the face vectors keep their capacity so a recycled
+    // output doesn't allocate once it has grown to the usual chunk size
+    virtual void mesh(const ChunkData& data, const float block_size, const uint32_t lod,
+        LayerMeshes<T>& out) const noexcept = 0;
+};
+
+// Mesher outputs recycled across chunks. A mesh goes back to the pool as soon
+// as its faces are copied to the staging buffer, only the counts are kept.
+// The pool only keeps a few usual sized outputs, the rest are freed on release.
+template<typename T>
+class MeshPool final
+{
+    std::vector<LayerMeshes<T>> m_free;
+    size_t m_capacity = 8;
+    std::mutex m_mutex;
+public:
+    // faces a layer may hold on to, about a surface chunk; bigger outputs are freed
+    static constexpr size_t MaxLayerFaces = 8192;
+
+    void set_capacity(const size_t capacity) noexcept
+    {
+        std::lock_guard lock(m_mutex);
+        m_capacity = capacity;
+        if (m_free.size() > m_capacity)
+            m_free.resize(m_capacity);
+    }
+    [[nodiscard]] LayerMeshes<T> acquire() noexcept
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_free.empty())
+            return {};
+        LayerMeshes<T> meshes = std::move(m_free.back());
+        m_free.pop_back();
+        return meshes;
+    }
+    void release(LayerMeshes<T>&& meshes) noexcept
+    {
+        // never used, nothing worth keeping
+        if (std::ranges::all_of(meshes, [](const ChunkMesh<T>& m){ return m.faces.capacity() == 0; }))
+            return;
+        if (std::ranges::any_of(meshes, [](const ChunkMesh<T>& m){ return m.faces.capacity() > MaxLayerFaces; }))
+            return;
+        for (auto& m : meshes)
+        {
+            m.faces.clear();
+            m.direction_count = {};
+        }
+        std::lock_guard lock(m_mutex);
+        if (m_free.size() < m_capacity)
+            m_free.emplace_back(std::move(meshes));
+    }
 };
 
+// Upper bound of the quads of a chunk, every visible face unmerged
+[[nodiscard]] size_t count_faces(const ChunkData& data) noexcept
+{
+    size_t count = 0;
+    for (const auto& plane : data.faces)
+    {
+        for (const uint32_t row : plane)
+            count += std::popcount(row);
+    }
+    return count;
+}
+// Upper bound of the quads of each BlockLayer, every visible face unmerged
+[[nodiscard]] std::array<size_t, BlockLayerCount> count_layer_faces(const ChunkData& data) noexcept
+{
+    std::array<size_t, BlockLayerCount> counts{};
+    // all the types in one layer, no need to look them up
+    const BlockLayer layer = material(data.palette[0]).layer;
+    if (std::ranges::all_of(data.palette, [layer](const BlockType t){ return material(t).layer == layer; }))
+    {
+        counts[static_cast<size_t>(layer)] = count_faces(data);
+        return counts;
+    }
+    for (const auto& plane : data.faces)
+    {
+        for (uint32_t row = 0; row < plane.size(); ++row)
+        {
+            for (uint32_t bits = plane[row]; bits != 0; bits &= bits - 1)
+            {
+                const BlockType type = data.type(row * data.size + std::countr_zero(bits));
+                ++counts[static_cast<size_t>(material(type).layer)];
+            }
+        }
+    }
+    return counts;
+}
+template<typename T>
+void prepare_output(const ChunkData& data, LayerMeshes<T>& out) noexcept
+{
+    const auto counts = count_layer_faces(data);
+    for (size_t l = 0; l < out.size(); ++l)
+    {
+        out[l].faces.clear();
+        out[l].faces.reserve(counts[l]);
+        out[l].direction_count = {};
+    }
+}
+
+// Face connectivity of a chunk: one bit per pair of its 6 faces, in Block::FaceIndex
+// order, set when a path of see-through blocks joins the two faces
+constexpr uint16_t AllFacesConnected = 0x7FFF;
+[[nodiscard]] constexpr uint32_t face_pair_bit(const uint32_t a, const uint32_t b) noexcept
+{
+    const uint32_t lo = std::min(a, b);
+    const uint32_t hi = std::max(a, b);
+    // rows of pairs starting with a lower face come first
+    return lo * (11 - lo) / 2 + (hi - lo - 1);
+}
+static_assert(face_pair_bit(4, 5) == 14, "15 pairs of faces");
+[[nodiscard]] constexpr bool see_through(const BlockType type) noexcept
+{
+    return type == BlockType::Air || type == BlockType::Water;
+}
+// Flood fills every see-through region of the chunk and joins all the faces it touches,
+// runs on the generation workers and again when an edit remeshes the chunk
+[[nodiscard]] uint16_t face_connectivity(const ChunkData& data) noexcept
+{
+    if (data.empty || std::ranges::all_of(data.palette, see_through))
+        return AllFacesConnected;
+    if (data.solid || std::ranges::none_of(data.palette, see_through))
+        return 0;
+    const uint32_t size = data.size;
+    const uint32_t layer = size * size;
+    // opaque blocks start out visited, per worker scratch
+    thread_local std::vector<uint8_t> visited;
+    thread_local std::vector<uint32_t> stack;
+    visited.resize(layer * size);
+    for (uint32_t idx = 0; idx < layer * size; ++idx)
+        visited[idx] = !see_through(data.type(idx));
+    uint16_t connectivity = 0;
+    for (uint32_t start = 0; start < layer * size; ++start)
+    {
+        if (visited[start])
+            continue;
+        visited[start] = 1;
+        stack.push_back(start);
+        uint32_t faces = 0;
+        while (!stack.empty())
+        {
+            const uint32_t idx = stack.back();
+            stack.pop_back();
+            const uint32_t x = idx % size;
+            const uint32_t z = idx / size % size;
+            const uint32_t y = idx / layer;
+            // touched faces as Block::Mask bits, U D F B L R
+            faces |= (y == size - 1) << 0 | (y == 0) << 1 | (z == size - 1) << 2 |
+                (z == 0) << 3 | (x == 0) << 4 | (x == size - 1) << 5;
+            const auto visit = [&](const bool inside, const uint32_t next)
+            {
+                if (inside && !visited[next])
+                {
+                    visited[next] = 1;
+                    stack.push_back(next);
+                }
+            };
+            visit(x > 0, idx - 1);
+            visit(x < size - 1, idx + 1);
+            visit(z > 0, idx - size);
+            visit(z < size - 1, idx + size);
+            visit(y > 0, idx - layer);
+            visit(y < size - 1, idx + layer);
+        }
+        for (uint32_t a = 0; a < 6; ++a)
+        {
+            for (uint32_t b = a + 1; b < 6; ++b)
+            {
+                if ((faces >> a & 1) && (faces >> b & 1))
+                    connectivity |= 1 << face_pair_bit(a, b);
+            }
+        }
+        if (connectivity == AllFacesConnected)
+            break;
+    }
+    return connectivity;
+}
+
 bool operator&(const uint8_t lhs, const Block::Mask rhs)
 {
     return lhs & static_cast<uint8_t>(rhs);
 }
 
-/// @brief Packs vertex data into a single 32-bit integer.
-/// Layout: [1b v | 1b u | 12b layer | 6b z | 6b y | 6b x]
-uint32_t pack_vertex(const glm::uvec3& pos, const glm::uvec2& uv, const glm::uvec2& grid)
+/// @brief Packs the quad origin and size into a single 32-bit integer.
+/// Layout: [2b free | 6b height | 6b width | 6b z | 6b y | 6b x]
+/// The size also counts the texture repeats across the merged quad.
+uint32_t pack_face(const glm::uvec3& pos, const glm::uvec2& size)
 {
-    const uint32_t layer = grid.y * 2 + grid.x;
-    const uint32_t px = pos.x & 0x3F; //  6 bits - off 0
-    const uint32_t py = pos.y & 0x3F; //  6 bits - off 6
-    const uint32_t pz = pos.z & 0x3F; //  6 bits - off 12
-    const uint32_t l = layer & 0xFFF; // 12 bits - off 18
-    const uint32_t u = uv.x & 0x01;   //  1 bit  - off 30
-    const uint32_t v = uv.y & 0x01;   //  1 bit  - off 31
+    const uint32_t px = pos.x & 0x3F;  //  6 bits - off 0
+    const uint32_t py = pos.y & 0x3F;  //  6 bits - off 6
+    const uint32_t pz = pos.z & 0x3F;  //  6 bits - off 12
+    const uint32_t w = size.x & 0x3F;  //  6 bits - off 18
+    const uint32_t h = size.y & 0x3F;  //  6 bits - off 24
 
-    return (px) | (py << 6) | (pz << 12) | (l << 18) | (u << 30) | (v << 31);
+    return (px) | (py << 6) | (pz << 12) | (w << 18) | (h << 24);
 }
 
-/// @brief Packs vertex data into a single 32-bit integer.
-/// Layout: [27b free | 4b occlusion | 3b face]
-uint32_t pack_vertex_ext(const uint32_t face_id, const uint32_t occlusion)
+/// @brief Packs face data into a single 32-bit integer.
+/// Layout: [13b free | 12b layer | 4b occlusion | 3b face]
+uint32_t pack_face_ext(const uint32_t face_id, const uint32_t occlusion, const glm::uvec2& grid)
 {
     const uint32_t face = face_id & 0x07;
     const uint32_t occ = occlusion & 0x0F;
-    return (face) | (occ << 3);
+    const uint32_t layer = (grid.y * 2 + grid.x) & 0xFFF;
+    return (face) | (occ << 3) | (layer << 7);
+}
+
+// Slice walk of a face direction, uses glm::vec3[i] component indices
+struct MeshSlice
+{
+    Block::Mask mask;
+    int8_t main_comp;
+    int8_t dir;
+    int8_t u_comp;
+    int8_t v_comp;
+    // winding, mirrored by FaceReversed in solid-flat.hlsl
+    bool flip;
+};
+constexpr auto MeshSlices = std::to_array<MeshSlice>({
+    {Block::Mask::U, 1, -1, 0, 2, false},
+    {Block::Mask::D, 1,  1, 0, 2, false},
+    {Block::Mask::F, 2, -1, 0, 1, true},
+    {Block::Mask::B, 2,  1, 0, 1, true},
+    {Block::Mask::L, 0,  1, 2, 1, false},
+    {Block::Mask::R, 0, -1, 2, 1, false}
+});
+
+// MeshSlices[Face] with static members, the kernels instantiated with it see
+// the component indices as constants
+template<int Face>
+struct StaticSlice
+{
+    static constexpr Block::Mask mask = MeshSlices[Face].mask;
+    static constexpr int8_t main_comp = MeshSlices[Face].main_comp;
+    static constexpr int8_t dir = MeshSlices[Face].dir;
+    static constexpr int8_t u_comp = MeshSlices[Face].u_comp;
+    static constexpr int8_t v_comp = MeshSlices[Face].v_comp;
+    static constexpr bool flip = MeshSlices[Face].flip;
+};
+
+template<typename S>
+[[nodiscard]] glm::uvec3 slice_point(const S& s, const uint32_t slice, const glm::uvec2& pos) noexcept
+{
+    glm::uvec3 v;
+    v[s.main_comp] = slice;
+    v[s.u_comp] = pos.x;
+    v[s.v_comp] = pos.y;
+    return v;
+}
+
+/// @brief Merge key of a visible face, never 0.
+/// Layout: [5b free | 19b face ext | 7b BlockLayer | 1b set]
+[[nodiscard]] uint32_t face_key(const ChunkData& data, const BlockMaterial& material,
+    const glm::uvec3& cell, const uint32_t idx, const uint32_t face_index) noexcept
+{
+    const auto world_cell = data.sector * static_cast<int32_t>(data.size) + glm::ivec3(cell);
+    const uint32_t water_depth = std::max<int32_t>(0, 7 + world_cell.y);
+    const uint32_t occ = data.touches_water(idx) ? water_depth : 7;
+    const uint32_t ext = pack_face_ext(face_index, occ, material.uvs[face_index]);
+    return (ext << 8) | (static_cast<uint32_t>(material.layer) << 1) | 1;
+}
+
+/// @brief Appends the x..x1, y..y1 quad of a slice plane.
+template<typename T, typename S>
+void emit_quad(LayerMeshes<T>& meshes, const S& s,
+    const uint32_t slice_plane, const uint32_t key, const uint32_t x, const uint32_t y,
+    const uint32_t x1, const uint32_t y1)
+{
+    auto& mesh = meshes[(key >> 1) & 0x7F];
+    mesh.faces.emplace_back(pack_face(slice_point(s, slice_plane, {x, y}), {x1 - x, y1 - y}), key >> 8);
+    ++mesh.direction_count[(key >> 8) & 0x07];
 }
 
 template<typename T>
 class GreedyMesher final : public ChunkMesher<T>
 {
-    [[nodiscard]] static bool is_inside(const glm::ivec3& world_cell, const glm::ivec3& sector,
-        const uint32_t chunk_size) noexcept
-    {
-        const auto edge = chunk_size - 1;
-        const glm::ivec3 local_cell = world_cell - sector * static_cast<int32_t>(chunk_size);
-        return local_cell.x >= 0 && local_cell.y >= 0 && local_cell.z >= 0 &&
-            local_cell.x <= edge && local_cell.y <= edge && local_cell.z <= edge;
-    }
-    [[nodiscard]] static bool is_edge(const glm::ivec3& world_cell, const glm::ivec3& sector,
-        const uint32_t chunk_size) noexcept
-    {
-        const auto edge = chunk_size - 1;
-        const glm::ivec3 local_cell = world_cell - sector * static_cast<int32_t>(chunk_size);
-        return local_cell.x == 0 || local_cell.y == 0 || local_cell.z == 0 ||
-            local_cell.x == edge || local_cell.y == edge || local_cell.z == edge;
-    }
 public:
-    [[nodiscard]] std::unordered_map<BlockLayer, ChunkMesh<T>> mesh(
-        const ChunkData& data, const float block_size, const uint32_t lod) const noexcept override
+    void mesh(const ChunkData& data, const float block_size, const uint32_t lod,
+        LayerMeshes<T>& meshes) const noexcept override
     {
-        struct Slice
-        {
-            Block::Mask mask;
-            // uses glm::vec3[i] component index
-            int8_t main_comp;
-            int8_t dir;
-            int8_t u_comp;
-            int8_t v_comp;
-            bool flip;
-        };
-        const auto slices = std::to_array<Slice>({
-            {Block::Mask::U, 1, -1, 0, 2, false},
-            {Block::Mask::D, 1,  1, 0, 2, false},
-            {Block::Mask::F, 2, -1, 0, 1, true},
-            {Block::Mask::B, 2,  1, 0, 1, true},
-            {Block::Mask::L, 0,  1, 2, 1, false},
-            {Block::Mask::R, 0, -1, 2, 1, false}
-        });
-
         const uint32_t size = data.size;
-        std::unordered_map<BlockLayer, ChunkMesh<T>> meshes;
-        for (int face_index = 0; face_index < slices.size(); ++face_index)
+        const uint32_t steps = (size + lod - 1) / lod;
+        prepare_output(data, meshes);
+        // Per slice merge keys, 0 where there is no visible face. Only faces that
+        // would render identically share a key and end up in the same quad.
+        std::array<uint32_t, ChunkData::MaxSize * ChunkData::MaxSize> keys;
+        for (int face_index = 0; face_index < MeshSlices.size(); ++face_index)
         {
-            const auto& [m, sc, d, uc, vc, flip] = slices[face_index];
+            const MeshSlice& s = MeshSlices[face_index];
             for (uint32_t slice = 0; slice < size; slice += lod)
             {
-                const bool edge = (slice == size) || (slice == 0);
-                for (uint32_t y = 0; y < size; y += lod)
+                const auto slice_cell = s.dir < 0 ? (size-1)-slice : slice;
+                const auto slice_plane = s.dir < 0 ? (size)-slice : slice;
+                for (uint32_t j = 0; j < steps; ++j)
                 {
-                    for (uint32_t x = 0; x < size; x += lod)
+                    for (uint32_t i = 0; i < steps; ++i)
                     {
-                        const auto slice_cell = d < 0 ? (size-1)-slice : slice;
-                        const auto to_cell = [sc, uc, vc, slice_cell](const glm::uvec2& pos)
-                        {
-                            glm::uvec3 v;
-                            v[sc] = slice_cell;
-                            v[uc] = pos.x;
-                            v[vc] = pos.y;
-                            return v;
-                        };
-                        auto slice_plane = d < 0 ? (size)-slice : slice;
-                        const auto to_plane = [sc, uc, vc, slice_plane](const glm::uvec2& pos)
-                        {
-                            glm::uvec3 v;
-                            v[sc] = slice_plane;
-                            v[uc] = pos.x;
-                            v[vc] = pos.y;
-                            return v;
-                        };
-                        const glm::uvec3 cell = to_cell({x, y});
+                        const glm::uvec3 cell = slice_point(s, slice_cell, {i * lod, j * lod});
                         const uint32_t idx = cell.x + cell.z * size + cell.y * size * size;
-                        if (data.blocks[idx].type == BlockType::Air)
+                        const BlockType type = data.type(idx);
+                        uint32_t key = 0;
+                        if (type != BlockType::Air && data.face(face_index, idx))
+                            key = face_key(data, material(type), cell, idx, face_index);
+                        keys[j * steps + i] = key;
+                    }
+                }
+                for (uint32_t j = 0; j < steps; ++j)
+                {
+                    for (uint32_t i = 0; i < steps; ++i)
+                    {
+                        const uint32_t key = keys[j * steps + i];
+                        if (key == 0)
                             continue;
-                        const auto& [layer, mat] = materials.at(data.blocks[idx].type);
-                        auto& mesh = meshes[layer];
-                        const auto A = to_plane(glm::uvec2(x, y));
-                        const auto B = to_plane(glm::uvec2(x, y+lod));
-                        const auto C = to_plane(glm::uvec2(x+lod, y+lod));
-                        const auto D = to_plane(glm::uvec2(x+lod, y));
-                        constexpr auto CA = glm::uvec2{0, 1};
-                        constexpr auto CB = glm::uvec2{0, 0};
-                        constexpr auto CC = glm::uvec2{1, 0};
-                        constexpr auto CD = glm::uvec2{1, 1};
-                        if (/*edge ||*/ data.blocks[idx].face_mask & m)
+                        // grow along u first, then extend the whole run along v
+                        uint32_t w = 1;
+                        while (i + w < steps && keys[j * steps + i + w] == key)
+                            ++w;
+                        uint32_t h = 1;
+                        for (; j + h < steps; ++h)
                         {
-                            const auto world_cell = data.sector * static_cast<int32_t>(data.size) + glm::ivec3(cell);
-                            const uint32_t water_depth = std::max<int32_t>(0, 7 + world_cell.y);
-                            const uint32_t occ = data.blocks[idx].water_mask > 0 ? water_depth : 7;
-                            if (flip ? d > 0 : d < 0)
-                            {
-                                mesh.vertices.emplace_back(pack_vertex(A, CA, mat[face_index]), pack_vertex_ext(face_index, occ));
-                                mesh.vertices.emplace_back(pack_vertex(C, CC, mat[face_index]), pack_vertex_ext(face_index, occ));
-                                mesh.vertices.emplace_back(pack_vertex(B, CB, mat[face_index]), pack_vertex_ext(face_index, occ));
-                                mesh.vertices.emplace_back(pack_vertex(A, CA, mat[face_index]), pack_vertex_ext(face_index, occ));
-                                mesh.vertices.emplace_back(pack_vertex(D, CD, mat[face_index]), pack_vertex_ext(face_index, occ));
-                                mesh.vertices.emplace_back(pack_vertex(C, CC, mat[face_index]), pack_vertex_ext(face_index, occ));
-                            }
-                            else
-                            {
-                                mesh.vertices.emplace_back(pack_vertex(A, CA, mat[face_index]), pack_vertex_ext(face_index, occ));
-                                mesh.vertices.emplace_back(pack_vertex(B, CB, mat[face_index]), pack_vertex_ext(face_index, occ));
-                                mesh.vertices.emplace_back(pack_vertex(C, CC, mat[face_index]), pack_vertex_ext(face_index, occ));
-                                mesh.vertices.emplace_back(pack_vertex(A, CA, mat[face_index]), pack_vertex_ext(face_index, occ));
-                                mesh.vertices.emplace_back(pack_vertex(C, CC, mat[face_index]), pack_vertex_ext(face_index, occ));
-                                mesh.vertices.emplace_back(pack_vertex(D, CD, mat[face_index]), pack_vertex_ext(face_index, occ));
-                            }
+                            const auto row = keys.begin() + (j + h) * steps + i;
+                            if (!std::all_of(row, row + w, [key](const uint32_t k){ return k == key; }))
+                                break;
                         }
+                        for (uint32_t r = 0; r < h; ++r)
+                            std::fill_n(keys.begin() + (j + r) * steps + i, w, 0);
+                        const uint32_t x = i * lod;
+                        const uint32_t y = j * lod;
+                        emit_quad(meshes, s, slice_plane, key, x, y,
+                            std::min(x + w * lod, size), std::min(y + h * lod, size));
+                    }
+                }
+            }
+        }
+    }
+};
+
+// Same quads as GreedyMesher but works on the face bit planes of ChunkData: the
+// visible faces of a slice are split into one 32-bit row mask per merge key and
+// merged with bit scans. Only walks visible faces, never the whole volume.
+template<typename T>
+class BinaryMesher final : public ChunkMesher<T>
+{
+    struct KeyPlane
+    {
+        uint32_t key;
+        std::array<uint32_t, ChunkData::MaxSize> rows;
+    };
+    // false runs the runtime slice and size kernel only, kept as the reference
+    bool m_specialized = true;
+
+    // One face direction. S is MeshSlice or StaticSlice, Size is the chunk size or 0 to
+    // read it from data: with both known the axis selection folds away and the row
+    // loops have constant trip counts.
+    template<typename S, uint32_t Size>
+    static void mesh_direction(const ChunkData& data, const S& s, const uint32_t face_index,
+        LayerMeshes<T>& meshes, std::vector<KeyPlane>& planes) noexcept
+    {
+        const uint32_t size = Size ? Size : data.size;
+        const auto& face_rows = data.faces[face_index];
+        // faces along x have u = z, their planes are stored with bit x, transpose them
+        std::array<uint32_t, ChunkData::MaxSize * ChunkData::MaxSize> transposed;
+        if (s.main_comp == 0)
+        {
+            transposed.fill(0);
+            for (uint32_t y = 0; y < size; ++y)
+            {
+                for (uint32_t z = 0; z < size; ++z)
+                {
+                    for (uint32_t bits = face_rows[y * size + z]; bits; bits &= bits - 1)
+                        transposed[std::countr_zero(bits) * size + y] |= 1u << z;
+                }
+            }
+        }
+        for (uint32_t slice = 0; slice < size; ++slice)
+        {
+            const auto slice_cell = s.dir < 0 ? (size-1)-slice : slice;
+            const auto slice_plane = s.dir < 0 ? (size)-slice : slice;
+            planes.clear();
+            for (uint32_t v = 0; v < size; ++v)
+            {
+                uint32_t row = s.main_comp == 0 ? transposed[slice_cell * size + v] :
+                    s.main_comp == 1 ? face_rows[slice_cell * size + v] : face_rows[v * size + slice_cell];
+                for (; row; row &= row - 1)
+                {
+                    const uint32_t u = std::countr_zero(row);
+                    const glm::uvec3 cell = slice_point(s, slice_cell, {u, v});
+                    const uint32_t idx = cell.x + cell.z * size + cell.y * size * size;
+                    const BlockType type = data.type(idx);
+                    if (type == BlockType::Air)
+                        continue;
+                    const uint32_t key = face_key(data, material(type), cell, idx, face_index);
+                    auto it = std::ranges::find(planes, key, &KeyPlane::key);
+                    if (it == planes.end())
+                        it = planes.insert(it, KeyPlane{key, {}});
+                    it->rows[v] |= 1u << u;
+                }
+            }
+            for (auto& [key, rows] : planes)
+            {
+                for (uint32_t v = 0; v < size; ++v)
+                {
+                    while (rows[v])
+                    {
+                        const uint32_t u = std::countr_zero(rows[v]);
+                        const uint32_t w = std::countr_one(rows[v] >> u);
+                        const uint32_t run = (w == 32 ? ~0u : (1u << w) - 1) << u;
+                        uint32_t h = 1;
+                        for (; v + h < size && (rows[v + h] & run) == run; ++h)
+                            rows[v + h] &= ~run;
+                        rows[v] &= ~run;
+                        emit_quad(meshes, s, slice_plane, key, u, v, u + w, v + h);
                     }
                 }
             }
         }
-        return std::move(meshes);
+    }
+    template<uint32_t Size>
+    static void mesh_directions(const ChunkData& data, LayerMeshes<T>& meshes,
+        std::vector<KeyPlane>& planes) noexcept
+    {
+        // in MeshSlices order, the output stays grouped by direction
+        [&]<int... Face>(std::integer_sequence<int, Face...>)
+        {
+            (mesh_direction<StaticSlice<Face>, Size>(data, StaticSlice<Face>{}, Face, meshes, planes), ...);
+        }(std::make_integer_sequence<int, MeshSlices.size()>{});
+    }
+public:
+    BinaryMesher() = default;
+    explicit BinaryMesher(const bool specialized) noexcept : m_specialized(specialized) { }
+    void mesh(const ChunkData& data, const float block_size, const uint32_t lod,
+        LayerMeshes<T>& meshes) const noexcept override
+    {
+        // coarse steps can't use the per cell planes
+        if (lod != 1)
+            return GreedyMesher<T>{}.mesh(data, block_size, lod, meshes);
+
+        prepare_output(data, meshes);
+        // per worker scratch, only grows when a slice has more keys than ever before
+        thread_local std::vector<KeyPlane> planes;
+        if (!m_specialized)
+        {
+            for (uint32_t face_index = 0; face_index < MeshSlices.size(); ++face_index)
+                mesh_direction<MeshSlice, 0>(data, MeshSlices[face_index], face_index, meshes, planes);
+            return;
+        }
+        // full chunks and the lod sizes
+        switch (data.size)
+        {
+        case 32: mesh_directions<32>(data, meshes, planes); break;
+        case 16: mesh_directions<16>(data, meshes, planes); break;
+        case 8: mesh_directions<8>(data, meshes, planes); break;
+        case 4: mesh_directions<4>(data, meshes, planes); break;
+        default: mesh_directions<0>(data, meshes, planes); break;
+        }
     }
 };
 }
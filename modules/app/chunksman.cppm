@@ -1,5 +1,6 @@
 module;
 #include <format>
+#include <algorithm>
 #include <array>
 #include <span>
 #include <vector>
@@ -9,7 +10,10 @@ module;
 #include <functional>
 #include <thread>
 #include <map>
+#include <utility>
 #include <mutex>
+#include <deque>
+#include <condition_variable>
 
 #include <enet.h>
 #include <future>
@@ -42,19 +46,32 @@ import :chunkmesh;
 import :systems;
 import :physics;
 import :client;
+import :resources;
+import ce.shaders.chunkcull;
 
 export namespace ce::app::chunksman
 {
 struct Chunk final
 {
     bool valid = false;
+    // placement of the mesh in the face buffers, swapped together with them by upload_mesh
+    // so the chunk keeps drawing its previous mesh until the new one is uploaded
     glm::mat4 transform{};
+    glm::ivec3 mesh_sector{};
+    uint32_t mesh_lod = 0;
     glm::vec4 color{};
     glm::ivec3 sector{};
-    std::unordered_map<BlockLayer, ChunkMesh<shaders::SolidFlatShader::VertexInput>> mesh;
-    std::unordered_map<BlockLayer, vk::BufferSuballocation> buffer{};
+    // pending upload, handed back to the mesh pool once copied to staging
+    LayerMeshes<shaders::SolidFlatShader::FaceInput> mesh;
+    std::array<vk::BufferSuballocation, BlockLayerCount> buffer{};
+    // uploaded faces per layer and direction, in MeshSlices order
+    std::array<std::array<uint32_t, 6>, BlockLayerCount> face_count{};
+    // pairs of faces joined through see-through blocks, see face_connectivity
+    uint16_t connectivity = AllFacesConnected;
     bool dirty = false;
     bool regenerate = false;
+    // voxels were edited in place, only the mesh needs to be rebuilt
+    bool remesh = false;
     ChunkData data;
     JPH::RefConst<JPH::Shape> shape;
     JPH::BodyID body_id;
@@ -64,36 +81,112 @@ struct Chunk final
     bool async_generating = false;
     uint32_t lod = 0;
 };
+struct GenerateTask
+{
+    std::shared_ptr<Chunk> chunk;
+    glm::ivec3 sector{};
+    uint32_t lod = 1;
+    uint64_t epoch = 0;
+};
+struct GenerateResult
+{
+    std::shared_ptr<Chunk> chunk;
+    glm::ivec3 sector{};
+    uint32_t lod = 1;
+    uint64_t epoch = 0;
+    ChunkData data;
+    LayerMeshes<shaders::SolidFlatShader::FaceInput> mesh;
+    uint16_t connectivity = AllFacesConnected;
+};
 struct ChunkUpdate
 {
-    std::map<BlockType, ChunkMesh<shaders::SolidFlatShader::VertexInput>> data;
+    std::map<BlockType, ChunkMesh<shaders::SolidFlatShader::FaceInput>> data;
     size_t chunk_index = 0;
     glm::vec4 color{};
     glm::ivec3 sector{};
 };
 struct ChunksState
 {
+    // chunk objects and face records for the layer's pipeline
     VkDescriptorSet object_descriptor_set = VK_NULL_HANDLE;
-    //vk::BufferSuballocation vertex_buffer{};
-    vk::BufferSuballocation uniform_buffer{};
-    vk::BufferSuballocation args_buffer{};
-    uint32_t draw_count = 0;
 };
-struct BatchDraw
+// Resident chunks addressed by sector modulo the ring width on each axis. The widest ring
+// around the camera is exactly Side sectors wide, so every sector in it owns a distinct
+// slot and a slot holding any other sector is out of range and free to be recycled.
+class ChunkGrid
 {
-    std::vector<shaders::SolidFlatShader::PerObjectBuffer> ubo;
-    std::vector<VkDrawIndirectCommand> draw_args;
-    uint32_t draw_count = 0;
+public:
+    static constexpr int32_t Side = globals::MaxChunkRings * 2 + 1;
+    static constexpr size_t Slots = Side * Side * Side;
+    [[nodiscard]] static size_t slot(const glm::ivec3& sector) noexcept
+    {
+        const glm::ivec3 m = (sector % Side + Side) % Side;
+        return m.x + m.z * Side + m.y * Side * Side;
+    }
+    [[nodiscard]] std::shared_ptr<Chunk>& at(const glm::ivec3& sector) noexcept
+    {
+        return m_slots[slot(sector)];
+    }
+    [[nodiscard]] const std::shared_ptr<Chunk>& at_slot(const size_t index) const noexcept
+    {
+        return m_slots[index];
+    }
+    // The chunk reserved for sector, nullptr when the slot is empty or holds another sector
+    [[nodiscard]] const std::shared_ptr<Chunk>* find(const glm::ivec3& sector) const noexcept
+    {
+        const auto& chunk = m_slots[slot(sector)];
+        return chunk && chunk->sector == sector ? &chunk : nullptr;
+    }
+    void clear() noexcept
+    {
+        std::ranges::fill(m_slots, nullptr);
+    }
+private:
+    std::array<std::shared_ptr<Chunk>, Slots> m_slots{};
 };
 struct ChunksManager
 {
+    // every allocated chunk, for iteration, m_grid indexes the same chunks by sector
     std::vector<std::shared_ptr<Chunk>> m_chunks;
+    ChunkGrid m_grid;
+    static_assert(globals::ChunkSize <= ChunkData::MaxSize, "ChunkData rows are 32 bits wide");
     FlatGenerator generator{globals::ChunkSize, 10};
-    GreedyMesher<shaders::SolidFlatShader::VertexInput> mesher{};
+    BinaryMesher<shaders::SolidFlatShader::FaceInput> mesher{};
+    MeshPool<shaders::SolidFlatShader::FaceInput> m_mesh_pool;
     // std::vector<uint32_t> m_chunk_updates;
-    TracyLockable(std::mutex, m_chunks_mutex);
-    std::thread m_chunks_thread;
-    std::unordered_map<BlockLayer, ChunksState> m_chunks_state;
+    // generation workers, fed by update_chunks through m_tasks
+    std::vector<std::thread> m_workers;
+    uint32_t m_workers_count = 1;
+    std::deque<GenerateTask> m_tasks;
+    std::mutex m_tasks_mutex;
+    std::condition_variable m_tasks_cv;
+    std::atomic_uint32_t m_tasks_pending = 0;
+    // finished chunks pushed by the workers, drained by update_chunks into m_ready, which
+    // only the render thread touches, and applied a few per frame
+    utils::MpscQueue<GenerateResult> m_results;
+    std::deque<GenerateResult> m_ready;
+    static constexpr uint32_t MaxResultsPerFrame = 16;
+    // bumped by clear_chunks to drop results of tasks already in flight
+    std::atomic_uint64_t m_epoch = 0;
+    std::array<ChunksState, BlockLayerCount> m_chunks_state{};
+    // GPU culling reads one record and the vertex shader one object per grid slot, both
+    // rewritten only for the slots flagged here
+    static_assert(ChunkGrid::Slots <= resources::VulkanResources::MaxChunkSlots);
+    static_assert(BlockLayerCount == shaders::ChunkCullShader::CullLayers);
+    std::vector<uint32_t> m_dirty_slots;
+    std::array<bool, ChunkGrid::Slots> m_slot_dirty{};
+    // records outside the ring around this sector are left invalid
+    glm::ivec3 m_cull_sector{};
+    // cave culling walk, see update_reachable
+    std::array<glm::uvec4, shaders::ChunkCullShader::ReachableWords> m_reachable{};
+    std::array<uint8_t, ChunkGrid::Slots> m_entry_faces{};
+    std::vector<glm::ivec3> m_walk;
+    static_assert(ChunkGrid::Slots <= shaders::ChunkCullShader::ReachableWords * 128, "a bit per grid slot");
+    // CullConstants of the frame in frame_buffer, bound by World
+    vk::BufferSuballocation m_cull_constants{};
+    // Face ranges replaced, moved or dropped since the records were last uploaded. The GPU
+    // may draw from them until the records pointing elsewhere are queued, see retire.
+    std::vector<vk::BufferSuballocation> m_retired;
     std::vector<glm::ivec3> m_regenerate_sectors;
     std::atomic_bool needs_update = false;
     std::vector<std::pair<glm::ivec3, std::vector<uint8_t>>> chunks_to_sync;
@@ -102,11 +195,31 @@ struct ChunksManager
     std::unordered_map<glm::ivec3, std::vector<uint8_t>, IVec3Hash> chunks_netdata;
     std::vector<glm::ivec3> sectors_to_request;
     std::vector<glm::ivec3> sectors_to_wait;
-    bool m_running = true;
+    std::atomic_bool m_running = true;
     Frustum m_frustum[2];
+    uint32_t m_eyes = 0;
     glm::vec3 cam_pos = { 0, 10, 0 };
+    glm::vec3 cam_velocity = { 0, 0, 0 };
+    glm::vec3 m_view_forward = { 0, 0, -1 };
+    // where the camera is heading, work is prioritized around it
+    glm::vec3 m_predicted_pos = { 0, 10, 0 };
+    // heading the queued tasks were picked for
+    glm::ivec3 m_schedule_sector = { 0, 0, 0 };
+    glm::vec3 m_schedule_forward = { 0, 0, -1 };
+    struct Candidate
+    {
+        float priority = 0;
+        glm::ivec3 sector{};
+        uint32_t lod = 1;
+    };
+    std::vector<Candidate> m_candidates;
+    std::vector<std::pair<float, std::shared_ptr<Chunk>>> m_uploads;
+    // mesh bytes copied this frame, checked against globals::upload_budget
+    size_t m_upload_bytes = 0;
+    std::vector<std::pair<Chunk*, size_t>> m_relocations;
     glm::ivec3 cam_sector = { 0, 0, 0 };
-    uint64_t last_timeline_value = 0;
+    // rings streamed around the camera, see set_rings
+    uint32_t m_rings = globals::MaxChunkRings;
     std::vector<glm::ivec3> neighbors;
 
     std::function<void(const glm::ivec3& sector)> on_sector_sync;
@@ -120,37 +233,102 @@ struct ChunksManager
         }
         else
         {
-            if (generate_chunks(32))
-                needs_update.store(true);
-            m_chunks_thread = std::thread(&ChunksManager::generate_thread, this);
+            m_workers_count = globals::generate_workers > 0 ? globals::generate_workers :
+                std::max(2u, std::thread::hardware_concurrency()) - 1;
+            LOGI("starting %u chunk generation workers", m_workers_count);
+            // a couple of outputs per worker plus the main thread's remeshes
+            m_mesh_pool.set_capacity((m_workers_count + 1) * 2);
+            for (uint32_t i = 0; i < m_workers_count; ++i)
+                m_workers.emplace_back(&ChunksManager::worker_thread, this, i);
+            // the cull buffer starts out undefined
+            for (uint32_t i = 0; i < ChunkGrid::Slots; ++i)
+                touch_slot(i);
+            // the records and constants of a frame always get their staging, however much
+            // the chunk uploads took
+            using ChunkCullInput = shaders::ChunkCullShader::ChunkCullInput;
+            using PerObjectBuffer = shaders::SolidFlatShader::PerObjectBuffer;
+            using CullConstants = shaders::ChunkCullShader::CullConstants;
+            constexpr VkDeviceSize cull_bytes = sizeof(CullConstants) + 16 +
+                ChunkGrid::Slots * (sizeof(ChunkCullInput) + sizeof(PerObjectBuffer)) + 16;
+            globals::m_resources->upload_ring.set_reserve(cull_bytes * 2);
+            generate_chunks(m_workers_count * 2);
         }
         return true;
     }
-    void generate_thread() noexcept
+    void worker_thread(const uint32_t worker_index) noexcept
     {
-        tracy::SetThreadName("generate_thread");
-        while (m_running)
+        tracy::SetThreadName(std::format("generate_worker_{}", worker_index).c_str());
+        while (true)
         {
-            if (generate_chunks(10))
-                needs_update.store(true);
+            GenerateTask task;
+            {
+                std::unique_lock lock(m_tasks_mutex);
+                m_tasks_cv.wait(lock, [this]{ return !m_running || !m_tasks.empty(); });
+                if (!m_running)
+                    return;
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            ZoneScopedN("generate_task");
+            GenerateResult result{
+                .chunk = std::move(task.chunk),
+                .sector = task.sector,
+                .lod = task.lod,
+                .epoch = task.epoch,
+                .data = generator.generate(task.sector, task.lod),
+            };
+            if (!result.data.empty && !result.data.solid)
+                result.mesh = mesh_chunk(result.data, task.lod);
+            result.connectivity = face_connectivity(result.data);
+            m_results.push(std::move(result));
+            --m_tasks_pending;
+            needs_update = true;
         }
     }
+    void enqueue_chunk(const std::shared_ptr<Chunk>& chunk, const glm::ivec3& sector, const uint32_t lod) noexcept
+    {
+        // the chunk is reserved for this sector until the result comes back
+        chunk->sector = sector;
+        chunk->connectivity = AllFacesConnected;
+        chunk->regenerate = false;
+        chunk->async_generating = true;
+        ++m_tasks_pending;
+        {
+            std::lock_guard lock(m_tasks_mutex);
+            m_tasks.emplace_back(chunk, sector, lod, m_epoch.load());
+        }
+        m_tasks_cv.notify_one();
+    }
     void destroy() noexcept
     {
-        m_running = false;
-        if (m_chunks_thread.joinable())
-            m_chunks_thread.join();
+        {
+            std::lock_guard lock(m_tasks_mutex);
+            m_running = false;
+            m_tasks.clear();
+        }
+        m_tasks_cv.notify_all();
+        for (auto& worker : m_workers)
+        {
+            if (worker.joinable())
+                worker.join();
+        }
+        m_workers.clear();
         if (globals::server_mode)
             generator.save();
         for (auto& c : m_chunks)
         {
-            for (auto& [k, b] : c->buffer)
-                globals::m_resources->vertex_buffer.subfree(b);
+            for (auto& b : c->buffer)
+            {
+                if (b.alloc)
+                    globals::m_resources->face_buffer.subfree(b);
+            }
         }
-        clear_chunks_state(0);
+        for (const auto& b : m_retired)
+            globals::m_resources->face_buffer.subfree(b);
+        m_retired.clear();
     }
-    [[nodiscard]] std::vector<glm::ivec3> generate_neighbors(const glm::ivec3 origin,
-        const int32_t size) const noexcept
+    [[nodiscard]] static std::vector<glm::ivec3> generate_neighbors(const glm::ivec3 origin,
+        const int32_t size) noexcept
     {
         ZoneScoped;
         const uint32_t chunk_count = utils::pow(size * 2 + 1, 3);
@@ -170,44 +348,124 @@ struct ChunksManager
         }
         return neighbors;
     }
-    [[nodiscard]] uint32_t chunk_lod(const glm::ivec3& chunk_sector, const glm::ivec3& cur_sector) const noexcept
+    // Offsets of the sectors in the widest ring nearest first, sorted once and translated
+    // by the camera sector wherever the ring is walked
+    [[nodiscard]] static const std::vector<glm::ivec3>& spiral_offsets() noexcept
+    {
+        static const std::vector<glm::ivec3> offsets = []
+        {
+            auto offsets = generate_neighbors({0, 0, 0}, globals::MaxChunkRings);
+            std::ranges::stable_sort(offsets, {}, [](const glm::ivec3& o){ return o.x * o.x + o.y * o.y + o.z * o.z; });
+            return offsets;
+        }();
+        return offsets;
+    }
+    // Distance in chunks where each lod level starts. The farthest chunk of the ring is a corner
+    // sqrt(3) * MaxChunkRings away, so the levels are placed as shares of the ring: half
+    // resolution past the middle of the faces, quarter resolution toward the corners.
+    static constexpr float RingRadius = static_cast<float>(globals::MaxChunkRings);
+    static constexpr auto LodDistances = std::to_array<std::pair<float, uint32_t>>({
+        {RingRadius, 2}, {RingRadius * 1.5f, 4},
+    });
+    static_assert(LodDistances.back().first < RingRadius * 1.732f, "lod level out of the chunk ring");
+    // A chunk keeps its level until it's this far past the boundary, so moving
+    // back and forth across a ring doesn't regenerate it every time
+    static constexpr float LodHysteresis = 0.75f;
+    [[nodiscard]] static uint32_t lod_at(const float dist) noexcept
     {
-        return 1;
-        const float dist = glm::gtx::distance(glm::vec3(chunk_sector), glm::vec3(cur_sector));
         uint32_t lod = 1;
-        if (dist >= 5)
-            lod = 2;
-        if (dist >= 8)
-            lod = 4;
-        if (dist >= 12)
-            lod = 8;
-        //if (dist >= 16)
-        //    lod = 16;
+        for (const auto& [min_dist, level] : LodDistances)
+        {
+            if (dist >= min_dist)
+                lod = level;
+        }
         return lod;
     }
-    [[nodiscard]] bool generate_chunks(uint32_t chunks_to_generate) noexcept
+    [[nodiscard]] uint32_t chunk_lod(const glm::ivec3& chunk_sector, const glm::ivec3& cur_sector,
+        const uint32_t current_lod = 0) const noexcept
     {
-        static bool i_have_done_something = false;
-        static uint32_t things_done = 0;
-        if (!i_have_done_something || things_done > 10)
+        const float dist = glm::gtx::distance(glm::vec3(chunk_sector), glm::vec3(cur_sector));
+        const uint32_t lod = lod_at(dist);
+        if (current_lod != 0 && lod != current_lod &&
+            (lod_at(dist - LodHysteresis) == current_lod || lod_at(dist + LodHysteresis) == current_lod))
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            things_done = 0;
+            return current_lod;
         }
-        i_have_done_something = false;
-        std::lock_guard lock(m_chunks_mutex);
-
-        constexpr uint32_t chunk_count = utils::pow(globals::ChunkRings * 2 + 1, 3);
+        return lod;
+    }
+    // Seconds of travel looked ahead, and the most chunks the prediction may lead the camera by
+    static constexpr float PredictionTime = 1.f;
+    static constexpr float PredictionMaxChunks = 3.f;
+    // Sectors out of view count as this much farther away
+    static constexpr float OffscreenPenalty = 2.f;
+    // Queued tasks are taken back when the view turns by more than ~30 degrees
+    static constexpr float PreemptAngleCos = 0.87f;
+    [[nodiscard]] bool sector_in_view(const glm::ivec3& sector) const noexcept
+    {
+        constexpr float chunk_world_size = globals::ChunkSize * globals::BlockSize;
+        const glm::vec3 min_corner = glm::vec3(sector) * chunk_world_size;
+        const AABB aabb{.min = min_corner, .max = min_corner + glm::vec3(chunk_world_size)};
+        for (uint32_t eye = 0; eye < m_eyes; eye++)
+        {
+            if (m_frustum[eye].is_box_visible(aabb))
+                return true;
+        }
+        // nothing has been drawn yet
+        return m_eyes == 0;
+    }
+    // Lower goes first: distance in chunks from where the camera is heading, sectors out of
+    // view pushed back except the ones around the camera that physics needs anyway
+    [[nodiscard]] float sector_priority(const glm::ivec3& sector) const noexcept
+    {
+        constexpr float chunk_world_size = globals::ChunkSize * globals::BlockSize;
+        const glm::vec3 center = (glm::vec3(sector) + 0.5f) * chunk_world_size;
+        const float dist = glm::gtx::distance(center, m_predicted_pos) / chunk_world_size;
+        const glm::ivec3 d = glm::abs(sector - cam_sector);
+        if (std::max({d.x, d.y, d.z}) > 1 && !sector_in_view(sector))
+            return dist * OffscreenPenalty;
+        return dist;
+    }
+    void predict_camera() noexcept
+    {
+        constexpr float chunk_world_size = globals::ChunkSize * globals::BlockSize;
+        constexpr float max_lead = PredictionMaxChunks * chunk_world_size;
+        glm::vec3 lead = cam_velocity * PredictionTime;
+        if (const float len = glm::length(lead); len > max_lead)
+            lead *= max_lead / len;
+        m_predicted_pos = cam_pos + lead;
+    }
+    // Takes back the tasks no worker has started yet, their chunks are scheduled again by
+    // priority on this pass
+    void preempt_tasks() noexcept
+    {
+        std::deque<GenerateTask> tasks;
+        {
+            std::lock_guard lock(m_tasks_mutex);
+            tasks.swap(m_tasks);
+        }
+        for (const auto& task : tasks)
+        {
+            // The chunk already took the new sector but still holds the voxels, mesh and buffers
+            // of the old one: update_cell and cull_record treat it as stale until it's generated
+            task.chunk->async_generating = false;
+            task.chunk->regenerate = true;
+            --m_tasks_pending;
+        }
+        if (!tasks.empty())
+            LOGI("preempted %zu chunk tasks", tasks.size());
+    }
+    // Schedules the sectors that are missing, out of date or at the wrong lod, best priority first
+    void generate_chunks(uint32_t chunks_to_generate) noexcept
+    {
         const glm::ivec3 cur_sector =
             glm::floor(cam_pos / (globals::ChunkSize * globals::BlockSize));
 
-        neighbors = generate_neighbors(cur_sector, globals::ChunkRings);
-        std::ranges::sort(neighbors, [cur_sector](const glm::ivec3 a, const glm::ivec3 b)
+        neighbors.clear();
+        for (const auto& offset : spiral_offsets())
         {
-            const float dist1 = glm::gtx::distance2(glm::vec3(a), glm::vec3(cur_sector));
-            const float dist2 = glm::gtx::distance2(glm::vec3(b), glm::vec3(cur_sector));
-            return dist1 < dist2;
-        });
+            if (in_ring(cur_sector + offset, cur_sector))
+                neighbors.push_back(cur_sector + offset);
+        }
 
         if (!globals::server_mode && systems::m_client_system->connected())
         {
@@ -217,47 +475,29 @@ struct ChunksManager
                 if (!chunks_netstate.contains(sector) && !std::ranges::contains(sectors_to_request, sector))
                 {
                     sectors_to_request.emplace_back(sector);
-                    i_have_done_something = true;
                 }
             }
+            // the server answers in request order
+            std::ranges::sort(sectors_to_request, {}, [this](const glm::ivec3& sector){ return sector_priority(sector); });
         }
 
-        // for (auto& chunk : m_chunks)
-        // {
-        //
-        // }
-
-        std::vector<size_t> chunk_indices;
-        chunk_indices.reserve(chunk_count);
-        for (size_t i = 0; i < m_chunks.size(); ++i)
+        // a pass is needed when a sector in range isn't resident yet or has to be regenerated
+        const bool pending = std::ranges::any_of(neighbors, [this](const glm::ivec3& sector)
         {
-            if (auto it = std::ranges::find(neighbors, m_chunks[i]->sector); it == neighbors.end())
-            {
-                chunk_indices.emplace_back(i);
-            }
-        }
-        const auto regenerate_count = std::ranges::count_if(m_chunks, [](auto& p){ return p->regenerate; });
-        if (m_chunks.size() < chunk_count || !chunk_indices.empty() ||
-            cam_sector != cur_sector || regenerate_count > 0)
+            const auto chunk = m_grid.find(sector);
+            return !chunk || (*chunk)->regenerate;
+        });
+        if (pending || cam_sector != cur_sector)
         {
             cam_sector = cur_sector;
-            if (m_chunks.size() < chunk_count)
-            {
-                // LOGI("Loading world: %d%%",
-                //     static_cast<int32_t>(m_chunks.size() * 100.f / chunk_count));
-            }
-            else
-            {
-                // LOGI("travel to sector [%d, %d, %d]", cam_sector.x, cam_sector.y, cam_sector.z);
-            }
         }
         else
         {
-            return false;
+            return;
         }
         ZoneScoped;
 
-        size_t chunk_indices_offset = 0;
+        m_candidates.clear();
         for (const auto& sector : neighbors)
         {
             if (const auto it = chunks_netstate.find(sector);
@@ -265,160 +505,548 @@ struct ChunksManager
             {
                 continue;
             }
-            // check if it's already present
-            const auto it = std::ranges::find(m_chunks, sector, [](auto& p){ return p->sector; });
-            if (it != m_chunks.end())
+            uint32_t lod = chunk_lod(sector, cur_sector);
+            if (const auto& chunk = m_grid.at(sector); chunk && chunk->sector == sector)
             {
-                auto& chunk = *it;
-                const uint32_t lod = chunk_lod(chunk->sector, cur_sector);
-                if (chunk->regenerate || chunk->lod != lod)
-                {
-                    auto blocks_data = generator.generate(sector, lod);
-                    if (!blocks_data.empty)
-                    {
-                        auto chunk_data = mesher.mesh(blocks_data, globals::BlockSize * lod, 1);
-                        chunk->lod = lod;
-                        chunk->mesh = std::move(chunk_data);
-                        chunk->data = std::move(blocks_data);
-                        chunk->color = glm::gtc::linearRand(glm::vec4(0, 0, 0, 1), glm::vec4(1, 1, 1, 1));
-                        chunk->sector = sector;
-                        chunk->transform = glm::gtc::translate(glm::vec3(sector) *
-                            globals::ChunkSize * globals::BlockSize) * glm::gtc::scale(glm::vec3(lod));
-                        chunk->dirty = true;
-                        chunk->regenerate = false;
-                        LOGI("re-generate chunk for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
-                        needs_update = true;
-                        if (!--chunks_to_generate)
-                            break;
-                    }
-                    else
-                    {
-                        chunk->lod = lod;
-                        chunk->mesh = {};
-                        chunk->data = {};
-                        chunk->sector = sector;
-                        chunk->dirty = false;
-                        LOGI("skip empty chunk for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
-                    }
-                }
+                lod = chunk_lod(sector, cur_sector, chunk->lod);
+                if (chunk->async_generating || (!chunk->regenerate && chunk->lod == lod))
+                    continue;
             }
-            else if (m_chunks.size() < chunk_count)
+            // the slot holds a sector that fell out of range, chunks still owned by a
+            // worker can't be recycled yet
+            else if (chunk && chunk->async_generating)
             {
-                const uint32_t lod = chunk_lod(sector, cur_sector);
-                auto& chunk = m_chunks.emplace_back(std::make_shared<Chunk>());
-                auto blocks_data = generator.generate(sector, lod);
-                if (!blocks_data.empty)
-                {
-                    auto chunk_data = mesher.mesh(blocks_data, globals::BlockSize * lod, 1);
-                    chunk->lod = lod;
-                    chunk->mesh = std::move(chunk_data);
-                    chunk->data = std::move(blocks_data);
-                    chunk->color = glm::gtc::linearRand(glm::vec4(0, 0, 0, 1), glm::vec4(1, 1, 1, 1));
-                    chunk->sector = sector;
-                    chunk->transform = glm::gtc::translate(glm::vec3(sector) *
-                        globals::ChunkSize * globals::BlockSize) * glm::gtc::scale(glm::vec3(lod));
-                    chunk->dirty = true;
-                    chunk->regenerate = false;
-                    LOGI("generate chunk for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
-                    needs_update = true;
-                    if (!--chunks_to_generate)
-                        break;
-                }
-                else
-                {
-                    chunk->lod = lod;
-                    chunk->mesh = {};
-                    chunk->data = {};
-                    chunk->sector = sector;
-                    chunk->dirty = false;
-                    LOGI("skip empty chunk for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
-                }
+                continue;
             }
-            else if (!chunk_indices.empty())
+            m_candidates.emplace_back(sector_priority(sector), sector, lod);
+        }
+        const auto count = std::min<size_t>(chunks_to_generate, m_candidates.size());
+        std::ranges::partial_sort(m_candidates, m_candidates.begin() + count, {}, &Candidate::priority);
+        for (const auto& [priority, sector, lod] : m_candidates | std::views::take(count))
+        {
+            auto& chunk = m_grid.at(sector);
+            if (!chunk)
+                chunk = m_chunks.emplace_back(std::make_shared<Chunk>());
+            enqueue_chunk(chunk, sector, lod);
+        }
+    }
+    void apply_results() noexcept
+    {
+        ZoneScoped;
+        m_results.drain(m_ready);
+        // stale results are dropped without counting against the budget
+        uint32_t applied = 0;
+        while (applied < MaxResultsPerFrame && !m_ready.empty())
+        {
+            GenerateResult result = std::move(m_ready.front());
+            m_ready.pop_front();
+            const auto& chunk = result.chunk;
+            chunk->async_generating = false;
+            // the chunk was cleared or recycled while the task was running
+            if (result.epoch != m_epoch || chunk->sector != result.sector)
             {
-                const uint32_t chunk_index = chunk_indices[chunk_indices_offset++];
-                const uint32_t lod = chunk_lod(sector, cur_sector);
-                auto& chunk = m_chunks[chunk_index];
-                auto blocks_data = generator.generate(sector, lod);
-                if (!blocks_data.empty)
-                {
-                    auto chunk_data = mesher.mesh(blocks_data, globals::BlockSize * lod, 1);
-                    chunk->lod = lod;
-                    chunk->mesh = std::move(chunk_data);
-                    chunk->data = std::move(blocks_data);
-                    chunk->color = glm::gtc::linearRand(glm::vec4(0, 0, 0, 1), glm::vec4(1, 1, 1, 1));
-                    chunk->sector = sector;
-                    chunk->transform = glm::gtc::translate(glm::vec3(sector) *
-                        globals::ChunkSize * globals::BlockSize) * glm::gtc::scale(glm::vec3(lod));
-                    chunk->dirty = true;
-                    chunk->regenerate = false;
-                    LOGI("re-generate chunk for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
-                    needs_update = true;
-                    if (!--chunks_to_generate)
-                        break;
-                }
-                else
-                {
-                    chunk->lod = lod;
-                    chunk->mesh = {};
-                    chunk->data = {};
-                    chunk->sector = sector;
-                    chunk->dirty = false;
-                    LOGI("skip empty chunk for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
-                }
+                m_mesh_pool.release(std::move(result.mesh));
+                continue;
+            }
+            // the ring shrank or the camera moved away while the task was running, set_rings
+            // left the chunk to its worker
+            if (!in_ring(result.sector, cam_sector))
+            {
+                m_mesh_pool.release(std::move(result.mesh));
+                release_chunk(chunk);
+                std::erase(m_chunks, chunk);
+                continue;
+            }
+            // a previous mesh that never made it to the GPU
+            m_mesh_pool.release(std::move(chunk->mesh));
+            chunk->connectivity = result.connectivity;
+            if (!result.data.empty)
+            {
+                chunk->lod = result.lod;
+                chunk->mesh = std::move(result.mesh);
+                chunk->data = std::move(result.data);
+                chunk->color = glm::gtc::linearRand(glm::vec4(0, 0, 0, 1), glm::vec4(1, 1, 1, 1));
+                chunk->dirty = true;
+                LOGI("generate chunk for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
             }
-            i_have_done_something = true;
-            things_done++;
+            else
+            {
+                chunk->lod = result.lod;
+                chunk->mesh = {};
+                // keeps the sector, an edit can fill it later
+                chunk->data = std::move(result.data);
+                // drops the buffers and the body of what was there before
+                chunk->dirty = true;
+                LOGI("skip empty chunk for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
+            }
+            ++applied;
         }
-        return true;
+    }
+    [[nodiscard]] uint32_t rings() const noexcept { return m_rings; }
+    // Generation, the server or the uploads are still catching up with the ring
+    [[nodiscard]] bool streaming() const noexcept
+    {
+        return m_tasks_pending.load() > 0 || !sectors_to_wait.empty() ||
+            std::ranges::any_of(m_uploads | std::views::values, [](const auto& chunk){ return chunk->dirty; });
+    }
+    // Moves the edge of the ring without clearing what's inside. Growing only widens what
+    // generate_chunks schedules and requests. Shrinking takes back the queued tasks and the
+    // requests not sent yet, and frees the chunks left outside. Chunks still owned by a worker
+    // are left to be recycled as usual.
+    void set_rings(const uint32_t rings) noexcept
+    {
+        const uint32_t previous = m_rings;
+        m_rings = std::clamp(rings, globals::MinChunkRings, globals::MaxChunkRings);
+        if (m_rings == previous)
+            return;
+        LOGI("chunk rings %u -> %u", previous, m_rings);
+        // chunks across the old or the new edge change validity in the cull records
+        for (const auto& chunk : m_chunks)
+        {
+            const int32_t distance = ring_distance(chunk->sector, m_cull_sector);
+            if ((distance <= static_cast<int32_t>(previous)) != (distance <= static_cast<int32_t>(m_rings)))
+                touch_record(*chunk);
+        }
+        if (m_rings > previous)
+            return;
+
+        const glm::ivec3 cur_sector =
+            glm::floor(cam_pos / (globals::ChunkSize * globals::BlockSize));
+        preempt_tasks();
+        std::erase_if(sectors_to_request, [&](const glm::ivec3& sector){ return !in_ring(sector, cur_sector); });
+        const size_t count = std::erase_if(m_chunks, [&](const std::shared_ptr<Chunk>& chunk)
+        {
+            if (chunk->async_generating || in_ring(chunk->sector, cur_sector))
+                return false;
+            release_chunk(chunk);
+            return true;
+        });
+        LOGI("released %zu chunks outside the ring", count);
+    }
+    // Frees the body, buffers and pending mesh of a chunk that is about to be dropped from
+    // m_chunks, and its grid slot if it still holds it
+    void release_chunk(const std::shared_ptr<Chunk>& chunk) noexcept
+    {
+        systems::m_physics_system->remove_body(chunk->body_id);
+        for (const auto& b : chunk->buffer)
+            retire(b);
+        m_mesh_pool.release(std::move(chunk->mesh));
+        if (auto& slot = m_grid.at(chunk->sector); slot == chunk)
+            slot = nullptr;
+        touch_record(*chunk);
     }
     void clear_chunks() noexcept
     {
-        std::lock_guard lock(m_chunks_mutex);
+        ++m_epoch;
 
         for (auto& chunk : m_chunks)
         {
             systems::m_physics_system->remove_body(chunk->body_id);
-            for (const auto& [layer, m] : chunk->mesh)
+            for (const auto& b : chunk->buffer)
+                retire(b);
+        }
+
+        m_chunks.clear();
+        m_grid.clear();
+        for (uint32_t i = 0; i < ChunkGrid::Slots; ++i)
+            touch_slot(i);
+    }
+    [[nodiscard]] LayerMeshes<shaders::SolidFlatShader::FaceInput> mesh_chunk(const ChunkData& data,
+        const uint32_t lod) noexcept
+    {
+        auto meshes = m_mesh_pool.acquire();
+        mesher.mesh(data, globals::BlockSize * lod, 1, meshes);
+        return meshes;
+    }
+    // Copies the pending mesh to the face buffer and hands the CPU side back to the pool,
+    // fails when the frame's upload budget, the upload ring or the face buffer is used up
+    // so the chunk retries on the next frame
+    [[nodiscard]] bool upload_mesh(Chunk& chunk) noexcept
+    {
+        using FaceInput = shaders::SolidFlatShader::FaceInput;
+        auto& face_buffer = globals::m_resources->face_buffer;
+        size_t size = 0;
+        for (const auto& mesh : chunk.mesh)
+            size += mesh.faces.size() * sizeof(FaceInput);
+        // the first chunk of a frame always goes, however big
+        if (m_upload_bytes > 0 && globals::upload_budget > 0 && m_upload_bytes + size > globals::upload_budget)
+            return false;
+
+        // every layer gets its range before anything is copied, a chunk is never left with
+        // some of its layers missing
+        std::array<vk::BufferSuballocation, BlockLayerCount> buffers{};
+        const auto free_buffers = [&]
+        {
+            for (const auto& b : buffers)
             {
-                if (chunk->buffer[layer].alloc)
-                {
-                    globals::m_resources->delete_buffers.emplace(last_timeline_value,
-                        std::pair(std::ref(globals::m_resources->vertex_buffer), chunk->buffer[layer]));
-                }
+                if (b.alloc)
+                    face_buffer.subfree(b);
             }
+        };
+        for (size_t l = 0; l < BlockLayerCount; ++l)
+        {
+            const auto& faces = chunk.mesh[l].faces;
+            if (faces.empty())
+                continue;
+            const auto dst_sb = face_buffer.suballoc(faces.size() * sizeof(FaceInput), 64);
+            if (!dst_sb)
+            {
+                LOGE("Failed to allocate %zu bytes of faces for sector [%d %d %d]",
+                    faces.size() * sizeof(FaceInput), chunk.sector.x, chunk.sector.y, chunk.sector.z);
+                free_buffers();
+                return false;
+            }
+            buffers[l] = *dst_sb;
+        }
+        std::optional<vk::BufferSuballocation> sb;
+        if (size > 0 && !(sb = globals::m_resources->upload_ring.alloc(size, 64)))
+        {
+            free_buffers();
+            return false;
         }
+        m_upload_bytes += size;
 
-        m_chunks.clear();
+        VkDeviceSize offset = 0;
+        for (size_t l = 0; l < BlockLayerCount; ++l)
+        {
+            const auto& faces = chunk.mesh[l].faces;
+            if (faces.empty())
+                continue;
+            const vk::BufferSuballocation src{VK_NULL_HANDLE, sb->offset + offset, faces.size() * sizeof(FaceInput),
+                static_cast<uint8_t*>(sb->ptr) + offset};
+            offset += src.size;
+            std::ranges::copy(faces, static_cast<FaceInput*>(src.ptr));
+            globals::m_resources->copy_buffers.emplace_back(face_buffer, src, buffers[l].offset);
+        }
+        for (size_t l = 0; l < BlockLayerCount; ++l)
+        {
+            retire(chunk.buffer[l]);
+            chunk.buffer[l] = buffers[l];
+            chunk.face_count[l] = buffers[l].alloc ? chunk.mesh[l].direction_count : std::array<uint32_t, 6>{};
+        }
+        chunk.mesh_sector = chunk.sector;
+        chunk.mesh_lod = chunk.lod;
+        chunk.transform = glm::gtc::translate(glm::vec3(chunk.sector) *
+            globals::ChunkSize * globals::BlockSize) * glm::gtc::scale(glm::vec3(chunk.lod));
+        touch_record(chunk);
+        LOGI("generate vertex for sector [%d %d %d]", chunk.sector.x, chunk.sector.y, chunk.sector.z);
+        m_mesh_pool.release(std::move(chunk.mesh));
+        chunk.mesh = {};
+        return true;
     }
-    void clear_chunks_state(const uint64_t timeline_value) noexcept
+    // Fragmentation of the face buffer above which chunk ranges get moved down, and how
+    // much is moved per frame
+    static constexpr float CompactFragmentation = 0.25f;
+    static constexpr VkDeviceSize CompactBytesPerFrame = 1 << 20;
+    static constexpr uint32_t CompactAttemptsPerFrame = 32;
+    // Moves the highest chunk ranges of the face buffer into the lowest free ranges that fit.
+    // The GPU copies run before this frame's uploads and the old ranges are retired.
+    void compact_faces() noexcept
     {
         ZoneScoped;
-        //if (m_chunks_state.vertex_buffer.alloc)
-        //    m_delete_buffers.emplace(timeline_value, std::pair(std::ref(m_vertex_buffer), m_chunks_state.vertex_buffer));
-        for (const auto& [layer, state] : m_chunks_state)
+        auto& face_buffer = globals::m_resources->face_buffer;
+        const auto stats = face_buffer.stats();
+        TracyPlot("Face Buffer Used", static_cast<int64_t>(stats.used));
+        TracyPlot("Face Buffer Fragmentation", stats.fragmentation);
+        if (stats.fragmentation < CompactFragmentation)
+            return;
+
+        m_relocations.clear();
+        for (const auto& chunk : m_chunks)
         {
-            if (state.uniform_buffer.alloc)
+            // about to be replaced by the upload of its new mesh
+            if (chunk->dirty)
+                continue;
+            for (size_t l = 0; l < BlockLayerCount; ++l)
             {
-                globals::m_resources->delete_buffers.emplace(timeline_value,
-                   std::pair(std::ref(globals::m_resources->object_buffer), state.uniform_buffer));
+                if (chunk->buffer[l].alloc)
+                    m_relocations.emplace_back(chunk.get(), l);
             }
-            if (state.args_buffer.alloc)
+        }
+        std::ranges::sort(m_relocations, std::ranges::greater{},
+            [](const auto& r){ return r.first->buffer[r.second].offset; });
+
+        VkDeviceSize moved = 0;
+        uint32_t attempts = 0;
+        for (const auto& [chunk, l] : m_relocations)
+        {
+            if (moved >= CompactBytesPerFrame || attempts++ >= CompactAttemptsPerFrame)
+                break;
+            auto& src = chunk->buffer[l];
+            const auto dst = face_buffer.suballoc(src.size, 64, VMA_VIRTUAL_ALLOCATION_CREATE_STRATEGY_MIN_OFFSET_BIT);
+            if (!dst)
+                break;
+            // no hole below fits this one
+            if (dst->offset >= src.offset)
+            {
+                face_buffer.subfree(*dst);
+                continue;
+            }
+            globals::m_resources->move_buffers.emplace_back(face_buffer, src, dst->offset);
+            retire(src);
+            src = *dst;
+            moved += src.size;
+            touch_record(*chunk);
+        }
+        if (moved > 0)
+            LOGI("compacted %llu bytes of chunk faces", static_cast<unsigned long long>(moved));
+    }
+    // Frees a face range once the records of the frame are queued, a record still pointing
+    // at it keeps drawing valid faces until then
+    void retire(const vk::BufferSuballocation& range) noexcept
+    {
+        if (range.alloc)
+            m_retired.push_back(range);
+    }
+    void touch_slot(const uint32_t index) noexcept
+    {
+        if (!std::exchange(m_slot_dirty[index], true))
+            m_dirty_slots.push_back(index);
+    }
+    // The culling record of the chunk's slot is uploaded again at the end of the frame
+    void touch_record(const Chunk& chunk) noexcept
+    {
+        touch_slot(static_cast<uint32_t>(ChunkGrid::slot(chunk.sector)));
+    }
+    [[nodiscard]] static int32_t ring_distance(const glm::ivec3& sector, const glm::ivec3& center) noexcept
+    {
+        const glm::ivec3 d = glm::abs(sector - center);
+        return std::max({d.x, d.y, d.z});
+    }
+    [[nodiscard]] bool in_ring(const glm::ivec3& sector, const glm::ivec3& center) const noexcept
+    {
+        return ring_distance(sector, center) <= static_cast<int32_t>(m_rings);
+    }
+    [[nodiscard]] shaders::ChunkCullShader::ChunkCullInput cull_record(const std::shared_ptr<Chunk>& chunk) const noexcept
+    {
+        using FaceInput = shaders::SolidFlatShader::FaceInput;
+        shaders::ChunkCullShader::ChunkCullInput record{};
+        // A dirty chunk keeps drawing its previous mesh until the new one is uploaded, unless
+        // that mesh belongs to another sector: the chunk was recycled or preempted. A stale
+        // slot is out of the ring.
+        if (!chunk || chunk->mesh_sector != chunk->sector || !in_ring(chunk->sector, m_cull_sector))
+            return record;
+        // bounds of the mesh in the buffers
+        constexpr float chunk_world_size = globals::ChunkSize * globals::BlockSize;
+        const glm::vec3 min_corner = glm::vec3(chunk->transform[3]);
+        record.BoundsMin = glm::vec4(min_corner, 1);
+        record.BoundsMax = glm::vec4(min_corner + chunk_world_size, 1);
+        for (size_t l = 0; l < BlockLayerCount; ++l)
+        {
+            if (!chunk->buffer[l].alloc)
+                continue;
+            record.Valid = 1;
+            record.FirstFace[l] = static_cast<uint32_t>(chunk->buffer[l].offset / sizeof(FaceInput));
+            std::ranges::copy(chunk->face_count[l], record.FaceCount + l * 6);
+        }
+        return record;
+    }
+    // Copies the records and objects of the touched slots, chunks only change validity across
+    // the edge of the ring when the camera enters another sector. The retired face ranges are
+    // freed with the frame that no longer points at them.
+    void update_cull_records(const glm::ivec3& cur_sector, const uint64_t timeline_value) noexcept
+    {
+        ZoneScoped;
+        using ChunkCullInput = shaders::ChunkCullShader::ChunkCullInput;
+        using PerObjectBuffer = shaders::SolidFlatShader::PerObjectBuffer;
+        if (cur_sector != m_cull_sector)
+        {
+            for (const auto& chunk : m_chunks)
+            {
+                if (in_ring(chunk->sector, cur_sector) != in_ring(chunk->sector, m_cull_sector))
+                    touch_record(*chunk);
+            }
+            m_cull_sector = cur_sector;
+        }
+        TracyPlot("Chunk Cull Records", static_cast<int64_t>(m_dirty_slots.size()));
+        const auto free_retired = [&]
+        {
+            for (const auto& range : m_retired)
             {
                 globals::m_resources->delete_buffers.emplace(timeline_value,
-                   std::pair(std::ref(globals::m_resources->args_buffer), state.args_buffer));
+                    std::pair(std::ref(globals::m_resources->face_buffer), range));
+            }
+            m_retired.clear();
+        };
+        if (m_dirty_slots.empty())
+            return free_retired();
+        // comes out of the ring's reserve, should it fail anyway the records stay dirty and
+        // the retired ranges alive until the next frame
+        const size_t count = m_dirty_slots.size();
+        const auto sb = globals::m_resources->upload_ring.alloc_reserved(
+            count * (sizeof(ChunkCullInput) + sizeof(PerObjectBuffer)), 16);
+        if (!sb)
+        {
+            LOGE("Failed to stage %zu chunk cull records", count);
+            return;
+        }
+        auto* records = static_cast<ChunkCullInput*>(sb->ptr);
+        auto* objects = reinterpret_cast<PerObjectBuffer*>(records + count);
+        const VkDeviceSize objects_offset = sb->offset + count * sizeof(ChunkCullInput);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t index = m_dirty_slots[i];
+            const auto& chunk = m_grid.at_slot(index);
+            records[i] = cull_record(chunk);
+            const vk::BufferSuballocation src{VK_NULL_HANDLE, sb->offset + i * sizeof(ChunkCullInput),
+                sizeof(ChunkCullInput), records + i};
+            globals::m_resources->copy_buffers.emplace_back(globals::m_resources->cull_buffer, src,
+                index * sizeof(ChunkCullInput));
+            m_slot_dirty[index] = false;
+            // the object of a slot without draws is never read
+            if (!records[i].Valid)
+                continue;
+            objects[i] = PerObjectBuffer{
+                .ObjectTransform = glm::transpose(chunk->transform),
+                .lod = chunk->mesh_lod,
+            };
+            const vk::BufferSuballocation object_src{VK_NULL_HANDLE, objects_offset + i * sizeof(PerObjectBuffer),
+                sizeof(PerObjectBuffer), objects + i};
+            globals::m_resources->copy_buffers.emplace_back(globals::m_resources->chunk_object_buffer, object_src,
+                index * sizeof(PerObjectBuffer));
+        }
+        m_dirty_slots.clear();
+        free_retired();
+    }
+    // Whether a chunk entered through the faces in entry, as Block::Mask bits, can be left through face
+    [[nodiscard]] static bool can_exit(const uint16_t connectivity, const uint32_t entry, const uint32_t face) noexcept
+    {
+        for (uint32_t e = 0; e < FaceOffsets.size(); ++e)
+        {
+            if ((entry >> e & 1) && e != face && (connectivity >> face_pair_bit(e, face) & 1))
+                return true;
+        }
+        return false;
+    }
+    // Cave culling: a breadth first walk of the ring from the camera's sector. It only steps
+    // away from the camera and into sectors in view, and leaves a chunk only through faces
+    // joined to one it came in by. Every step moves one sector farther, so all the ways into
+    // a chunk are known before it's left. Chunks it doesn't get to are behind opaque blocks.
+    void update_reachable(const glm::ivec3& cur_sector) noexcept
+    {
+        ZoneScoped;
+        m_reachable.fill(glm::uvec4(0));
+        m_entry_faces.fill(0);
+        m_walk.clear();
+        const auto reach = [this](const glm::ivec3& sector)
+        {
+            const size_t index = ChunkGrid::slot(sector);
+            auto& word = m_reachable[index / 128][index / 32 % 4];
+            const uint32_t bit = 1u << (index % 32);
+            if (word & bit)
+                return;
+            word |= bit;
+            m_walk.push_back(sector);
+        };
+        reach(cur_sector);
+        for (size_t i = 0; i < m_walk.size(); ++i)
+        {
+            const glm::ivec3 sector = m_walk[i];
+            const glm::ivec3 offset = sector - cur_sector;
+            const uint8_t entry = m_entry_faces[ChunkGrid::slot(sector)];
+            // a sector without its chunk yet doesn't hide anything
+            const auto chunk = m_grid.find(sector);
+            const uint16_t connectivity = chunk ? (*chunk)->connectivity : AllFacesConnected;
+            for (uint32_t f = 0; f < FaceOffsets.size(); ++f)
+            {
+                const glm::ivec3& step = FaceOffsets[f];
+                if (offset.x * step.x + offset.y * step.y + offset.z * step.z < 0)
+                    continue;
+                // the camera's chunk can be left through any face
+                if (i > 0 && !can_exit(connectivity, entry, f))
+                    continue;
+                const glm::ivec3 next = sector + step;
+                if (!in_ring(next, cur_sector))
+                    continue;
+                // faces come in opposite pairs, entered through the one facing back
+                m_entry_faces[ChunkGrid::slot(next)] |= 1 << (f ^ 1);
+                if (sector_in_view(next))
+                    reach(next);
             }
         }
-        m_chunks_state.clear();
+        TracyPlot("Chunks Reachable", static_cast<int64_t>(m_walk.size()));
+    }
+    void update_cull_constants(const std::array<glm::vec3, 2>& eye_pos, const uint64_t timeline_value) noexcept
+    {
+        using CullConstants = shaders::ChunkCullShader::CullConstants;
+        m_cull_constants = {};
+        const auto sb = globals::m_resources->upload_ring.alloc_reserved(sizeof(CullConstants), 16);
+        if (!sb)
+        {
+            LOGE("Failed to stage the chunk cull constants");
+            return;
+        }
+        const auto dst_sb = globals::m_resources->frame_buffer.suballoc(sizeof(CullConstants), 256);
+        if (!dst_sb)
+            return;
+        CullConstants constants{
+            .EyeCount = m_eyes,
+            .SlotCount = static_cast<uint32_t>(ChunkGrid::Slots),
+            .MaxDraws = resources::VulkanResources::MaxChunkDraws,
+            .BlockSize = globals::BlockSize,
+        };
+        for (uint32_t eye = 0; eye < m_eyes; eye++)
+        {
+            const auto& planes = m_frustum[eye].planes();
+            for (size_t i = 0; i < planes.size(); ++i)
+                constants.Planes[eye * planes.size() + i] = glm::vec4(planes[i].normal, planes[i].distance);
+            constants.Eyes[eye] = glm::vec4(eye_pos[eye], 1);
+        }
+        std::ranges::copy(m_reachable, constants.Reachable);
+        *static_cast<CullConstants*>(sb->ptr) = constants;
+        globals::m_resources->copy_buffers.emplace_back(globals::m_resources->frame_buffer, *sb, dst_sb->offset);
+        globals::m_resources->delete_buffers.emplace(timeline_value,
+            std::pair(std::ref(globals::m_resources->frame_buffer), *dst_sb));
+        m_cull_constants = *dst_sb;
     }
     void update_chunks(const vk::utils::FrameContext& frame) noexcept
     {
         ZoneScoped;
 
-        last_timeline_value = frame.timeline_value;
-        std::unique_lock lock(m_chunks_mutex, std::try_to_lock);
-        if (!lock.owns_lock())
-            return;
+        apply_results();
+
+        for (const auto& chunk : m_chunks)
+        {
+            if (!chunk->remesh)
+                continue;
+            chunk->remesh = false;
+            m_mesh_pool.release(std::exchange(chunk->mesh, mesh_chunk(chunk->data, chunk->lod)));
+            chunk->connectivity = face_connectivity(chunk->data);
+            chunk->dirty = true;
+        }
+
+        const glm::ivec3 cur_sector =
+            glm::floor(cam_pos / (globals::ChunkSize * globals::BlockSize));
+
+        m_eyes = globals::xrmode ? 2 : 1;
+        for (uint32_t eye = 0; eye < m_eyes; eye++)
+        {
+            const auto vp = frame.projection[eye] * frame.view[eye];
+            m_frustum[eye].update(vp);
+        }
+        std::array<glm::vec3, 2> eye_pos{};
+        for (uint32_t eye = 0; eye < m_eyes; eye++)
+            eye_pos[eye] = glm::vec3(glm::inverse(frame.view[eye])[3]);
+        m_view_forward = -glm::vec3(glm::inverse(frame.view[0])[2]);
+
+        predict_camera();
+        if (!m_workers.empty())
+        {
+            // tasks picked for another heading would only delay the ones needed now
+            const glm::ivec3 predicted_sector =
+                glm::floor(m_predicted_pos / (globals::ChunkSize * globals::BlockSize));
+            if (predicted_sector != m_schedule_sector || glm::dot(m_view_forward, m_schedule_forward) < PreemptAngleCos)
+            {
+                preempt_tasks();
+                m_schedule_sector = predicted_sector;
+                m_schedule_forward = m_view_forward;
+            }
+            // keep a couple of tasks queued per worker, the rest is scheduled on a later frame
+            // so that the ordering follows the camera as it moves
+            const uint32_t queue_size = m_workers_count * 2;
+            if (const uint32_t pending = m_tasks_pending.load(); pending < queue_size)
+                generate_chunks(queue_size - pending);
+        }
 
         if (!sectors_to_request.empty())
         {
@@ -452,159 +1080,51 @@ struct ChunksManager
             std::erase(sectors_to_wait, sector);
         }
 
-        const glm::ivec3 cur_sector =
-            glm::floor(cam_pos / (globals::ChunkSize * globals::BlockSize));
+        compact_faces();
 
-        const uint32_t eyes = globals::xrmode ? 2 : 1;
-        for (uint32_t eye = 0; eye < eyes; eye++)
+        // the upload budget of the frame goes to the chunks the camera is heading for first
+        bool optimize_physics = false;
+        m_upload_bytes = 0;
+        m_uploads.clear();
+        for (const auto& chunk : m_chunks)
         {
-            const auto vp = frame.projection[eye] * frame.view[eye];
-            m_frustum[eye].update(vp);
+            if (chunk->dirty && in_ring(chunk->sector, cur_sector))
+                m_uploads.emplace_back(sector_priority(chunk->sector), chunk);
         }
-
-        auto sorted_chunks = utils::sorted_view(m_chunks, [this](const auto& c1, const auto& c2) -> bool
+        std::ranges::sort(m_uploads, {}, &decltype(m_uploads)::value_type::first);
+        for (const auto& chunk : m_uploads | std::views::values)
         {
-            const float dist1 = glm::gtx::distance2(glm::vec3(c1->sector), glm::vec3(cam_pos));
-            const float dist2 = glm::gtx::distance2(glm::vec3(c2->sector), glm::vec3(cam_pos));
-            return dist1 < dist2;
-        });
-
-        int polys = 0;
-        std::unordered_map<BlockLayer, BatchDraw> batches;
-        bool optimize_physics = false;
-        for (auto& chunk : sorted_chunks)
-        {
-            // AABB Culling Check
-            constexpr float chunk_world_size = globals::ChunkSize * globals::BlockSize;
-            const glm::vec3 min_corner = glm::vec3(chunk->sector) * chunk_world_size;
-            const AABB chunk_aabb{
-                .min = min_corner,
-                .max = min_corner + glm::vec3(chunk_world_size),
-            };
-
-            // if (!m_frustum.is_box_visible(chunk_aabb))
-            //     continue; // Skip this chunk, it's not visible
-
-            for (const auto& [layer, m] : chunk->mesh)
+            if (!upload_mesh(*chunk))
+                continue;
+            LOGI("generate physics for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
+            systems::m_physics_system->remove_body(chunk->body_id);
+            const bool has_faces = std::ranges::any_of(chunk->face_count, [](const auto& counts)
             {
-                if (m.vertices.empty())
-                {
-                    if (chunk->buffer[layer].alloc)
-                    {
-                        globals::m_resources->delete_buffers.emplace(frame.timeline_value,
-                            std::pair(std::ref(globals::m_resources->vertex_buffer), chunk->buffer[layer]));
-                    }
-                    chunk->buffer.erase(layer);
-                    systems::m_physics_system->remove_body(chunk->body_id);
-                    continue;
-                }
-                if (chunk->dirty)
-                {
-                    LOGI("generate physics for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
-                    systems::m_physics_system->remove_body(chunk->body_id);
-                    if (chunk->lod <= 1)
-                    {
-                        if (auto result = systems::m_physics_system->create_chunk_body(
-                            globals::ChunkSize, globals::BlockSize, chunk->data, chunk->sector))
-                        {
-                            std::tie(chunk->body_id, chunk->shape) = result.value();
-                        }
-                    }
-
-                    if (const auto sb = globals::m_resources->staging_buffer.suballoc(m.vertices.size() *
-                        sizeof(shaders::SolidFlatShader::VertexInput), 64))
-                    {
-                        if (const auto dst_sb = globals::m_resources->vertex_buffer.suballoc(sb->size, 64))
-                        {
-                            std::ranges::copy(m.vertices, static_cast<shaders::SolidFlatShader::VertexInput*>(sb->ptr));
-                            globals::m_resources->copy_buffers.emplace_back(globals::m_resources->vertex_buffer, *sb, dst_sb->offset);
-                            //m_chunks_state.vertex_buffer = *dst_sb;
-
-                            if (chunk->buffer[layer].alloc)
-                            {
-                                globals::m_resources->delete_buffers.emplace(frame.timeline_value,
-                                   std::pair(std::ref(globals::m_resources->vertex_buffer), chunk->buffer[layer]));
-                            }
-                            chunk->buffer[layer] = *dst_sb;
-                            LOGI("generate vertex for sector [%d %d %d]", chunk->sector.x, chunk->sector.y, chunk->sector.z);
-                        }
-                        // defer suballocation deletion
-                        globals::m_resources->delete_buffers.emplace(frame.timeline_value,
-                            std::pair(std::ref(globals::m_resources->staging_buffer), *sb));
-                        if (on_sector_drawing)
-                            on_sector_drawing(chunk->sector);
-                    }
-                    optimize_physics = true;
-                }
-                const auto is_visible = [&]
-                {
-                    for (uint32_t eye = 0; eye < eyes; eye++)
-                        if (m_frustum[eye].is_box_visible(chunk_aabb))
-                            return true;
-                    return false;
-                };
-                if (is_visible())
+                return std::ranges::any_of(counts, [](const uint32_t n){ return n > 0; });
+            });
+            if (has_faces && chunk->lod <= 1)
+            {
+                if (auto result = systems::m_physics_system->create_chunk_body(
+                    globals::ChunkSize, globals::BlockSize, chunk->data, chunk->sector))
                 {
-                    batches[layer].ubo.push_back(shaders::SolidFlatShader::PerObjectBuffer{
-                        .ObjectTransform = glm::transpose(chunk->transform),
-                        .lod = chunk->lod,
-                    });
-                    const auto vertex_offset = chunk->buffer[layer].offset / sizeof(shaders::SolidFlatShader::VertexInput);
-                    batches[layer].draw_args.push_back({
-                        .vertexCount = static_cast<uint32_t>(m.vertices.size()),
-                        .instanceCount = 1,
-                        .firstVertex = static_cast<uint32_t>(vertex_offset),
-                        .firstInstance = 0
-                    });
-                    batches[layer].draw_count++;
-                    polys += m.vertices.size() / 3;
+                    std::tie(chunk->body_id, chunk->shape) = result.value();
                 }
             }
+            if (has_faces && on_sector_drawing)
+                on_sector_drawing(chunk->sector);
+            optimize_physics = true;
             chunk->dirty = false;
-            // chunk.mesh.clear();
         }
+        TracyPlot("Chunk Upload Bytes", static_cast<int64_t>(m_upload_bytes));
 
         if (optimize_physics)
             systems::m_physics_system->optimize();
 
-        // LOGI("drawing %d polys", polys / 3);
-        clear_chunks_state(frame.timeline_value);
-        for (const auto& [layer, batch] : batches)
-        {
-            if (const auto sb = globals::m_resources->staging_buffer.suballoc(batch.ubo.size() *
-                sizeof(shaders::SolidFlatShader::PerObjectBuffer), 64))
-            {
-                if (const auto dst_sb = globals::m_resources->object_buffer.suballoc(sb->size, 64))
-                {
-                    auto ubo_copy = batch.ubo;
-                    if (layer == BlockLayer::Transparent)
-                    {
-                        for (auto& ubo : ubo_copy)
-                            ubo.y_offset = -0.1f;
-                    }
-                    std::ranges::copy(ubo_copy, static_cast<shaders::SolidFlatShader::PerObjectBuffer*>(sb->ptr));
-                    globals::m_resources->copy_buffers.emplace_back(globals::m_resources->object_buffer, *sb, dst_sb->offset);
-                    m_chunks_state[layer].uniform_buffer = *dst_sb;
-                }
-                // defer suballocation deletion
-                globals::m_resources->delete_buffers.emplace(frame.timeline_value,
-                    std::pair(std::ref(globals::m_resources->staging_buffer), *sb));
-            }
-
-            if (const auto sb = globals::m_resources->staging_buffer.suballoc(batch.draw_args.size() * sizeof(VkDrawIndirectCommand), 64))
-            {
-                if (const auto dst_sb = globals::m_resources->args_buffer.suballoc(sb->size, 64))
-                {
-                    std::ranges::copy(batch.draw_args, static_cast<VkDrawIndirectCommand*>(sb->ptr));
-                    globals::m_resources->copy_buffers.emplace_back(globals::m_resources->args_buffer, *sb, dst_sb->offset);
-                    m_chunks_state[layer].args_buffer = *dst_sb;
-                }
-                // defer suballocation deletion
-                globals::m_resources->delete_buffers.emplace(frame.timeline_value,
-                    std::pair(std::ref(globals::m_resources->staging_buffer), *sb));
-            }
-            m_chunks_state[layer].draw_count = batch.draw_count;
-        }
+        // culling and draw generation run on the GPU, see ChunkCullShader
+        update_cull_records(cur_sector, frame.timeline_value);
+        update_reachable(cur_sector);
+        update_cull_constants(eye_pos, frame.timeline_value);
+        globals::m_resources->upload_ring.end_frame(frame.timeline_value);
         needs_update = false;
     }
     [[nodiscard]] std::optional<std::tuple<glm::ivec3, BlockType, glm::vec3, glm::ivec3>> trace_dda(const glm::vec3& origin,
@@ -615,7 +1135,7 @@ struct ChunksManager
         const auto hits = utils::traverse_3d_dda(origin, direction, glm::vec3(0), dist, globals::BlockSize);
         for (const auto& [cell, t, n] : hits)
         {
-            const BlockType b = generator.peek(cell);
+            const BlockType b = peek_resident(cell);
             if (hit_test(b))
             {
                 return std::tuple(cell, b, origin + t * direction, n);
@@ -623,6 +1143,25 @@ struct ChunksManager
         }
         return std::nullopt;
     }
+    // Reads the cell from the voxels of its chunk when they're resident at full resolution,
+    // which is a lookup instead of sampling the noise.
+    [[nodiscard]] BlockType peek_resident(const glm::ivec3& world_cell) const noexcept
+    {
+        const int32_t chunk_size = static_cast<int32_t>(globals::ChunkSize);
+        const glm::ivec3 sector = glm::floor(glm::vec3(world_cell) / static_cast<float>(chunk_size));
+        // a chunk on a worker still holds the voxels of the sector it had before
+        if (const auto slot = m_grid.find(sector))
+        {
+            const auto& chunk = *slot;
+            if (!chunk->async_generating && !chunk->regenerate && chunk->lod == 1 && !chunk->data.solid)
+            {
+                if (chunk->data.empty)
+                    return BlockType::Air;
+                return chunk->data.type(glm::uvec3(world_cell - sector * chunk_size));
+            }
+        }
+        return generator.peek(world_cell);
+    }
     [[nodiscard]] std::optional<std::tuple<glm::ivec3, BlockType, glm::vec3>> trace(const glm::vec3& origin,
         const glm::vec3& direction, const float dist, const float step, const auto hit_test) const noexcept
         requires std::invocable<decltype(hit_test), const BlockType> &&
@@ -643,51 +1182,59 @@ struct ChunksManager
         }
         return std::nullopt;
     }
-    [[nodiscard]] static bool is_inside(const glm::ivec3& world_cell, const glm::ivec3& sector) noexcept
+    // Applies an edit to the resident voxels instead of regenerating the sectors: the
+    // edited cell and its 6 neighbours, which may live in adjacent chunks, get their
+    // type and masks from the generator that already holds the edit.
+    void regenerate_block(const glm::ivec3& sector, const glm::u8vec3& local_cell) noexcept
     {
-        constexpr auto edge = globals::ChunkSize - 1;
-        const glm::ivec3 local_cell = world_cell - sector * static_cast<int32_t>(globals::ChunkSize);
-        return local_cell.x >= 0 && local_cell.y >= 0 && local_cell.z >= 0 &&
-            local_cell.x <= edge && local_cell.y <= edge && local_cell.z <= edge;
+        const glm::ivec3 world_cell = glm::ivec3(local_cell) + sector * static_cast<int32_t>(globals::ChunkSize);
+        update_cell(world_cell);
+        for (const auto& offset : FaceOffsets)
+            update_cell(world_cell + offset);
     }
-    [[nodiscard]] static bool is_edge(const glm::ivec3& world_cell, const glm::ivec3& sector) noexcept
+    // neighbour offsets in Block::FaceIndex order
+    static constexpr auto FaceOffsets = std::to_array<glm::ivec3>({
+        {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {-1, 0, 0}, {1, 0, 0},
+    });
+    void update_cell(const glm::ivec3& world_cell) noexcept
     {
-        constexpr auto edge = globals::ChunkSize - 1;
-        const glm::ivec3 local_cell = world_cell - sector * static_cast<int32_t>(globals::ChunkSize);
-        return local_cell.x == 0 || local_cell.y == 0 || local_cell.z == 0 ||
-            local_cell.x == edge || local_cell.y == edge || local_cell.z == edge;
-    }
-    void regenerate_block(const glm::ivec3& sector, const glm::u8vec3& local_cell) noexcept
-    {
-        std::lock_guard lock(m_chunks_mutex);
-        if (const auto it = std::ranges::find(m_chunks, sector, &Chunk::sector); it != m_chunks.end())
+        const int32_t chunk_size = static_cast<int32_t>(globals::ChunkSize);
+        const glm::ivec3 sector = glm::floor(glm::vec3(world_cell) / static_cast<float>(chunk_size));
+        const auto slot = m_grid.find(sector);
+        if (!slot)
+            return;
+        const auto& chunk = *slot;
+        // lod and buried chunks don't keep full resolution voxels, a chunk still on a
+        // worker may have sampled the terrain before the edit and a preempted one still
+        // holds the voxels of its previous sector
+        if (chunk->async_generating || chunk->regenerate || chunk->data.sector != sector ||
+            chunk->lod != 1 || chunk->data.solid)
         {
-            (*it)->regenerate = true;
+            chunk->regenerate = true;
+            return;
         }
-        if (is_edge(local_cell, sector))
+        std::array<BlockType, 6> neighbours;
+        for (size_t f = 0; f < FaceOffsets.size(); ++f)
+            neighbours[f] = generator.peek(world_cell + FaceOffsets[f]);
+        const Block block = FlatGenerator::make_block(generator.peek(world_cell), neighbours);
+
+        auto& data = chunk->data;
+        if (data.empty)
         {
-            const glm::ivec3 world_cell = glm::ivec3(local_cell) + sector * static_cast<int32_t>(globals::ChunkSize);
-            for (uint32_t axis = 0; axis < 3; ++axis)
-            {
-                for (const int32_t i : std::to_array({-1, 1}))
-                {
-                    glm::ivec3 adj_cell = world_cell;
-                    adj_cell[axis] += i;
-                    glm::ivec3 adj_sector = sector;
-                    adj_sector[axis] += i;
-                    if (is_inside(adj_cell, adj_sector))
-                    {
-                        if (const auto it = std::ranges::find(m_chunks, adj_sector, &Chunk::sector);
-                            it != m_chunks.end())
-                        {
-                            LOGI("regenerate edge block [%d %d %d] in sector [%d %d %d]",
-                                adj_cell.x, adj_cell.y, adj_cell.z, adj_sector.x, adj_sector.y, adj_sector.z);
-                            (*it)->regenerate = true;
-                        }
-                    }
-                }
-            }
+            if (block.type == BlockType::Air)
+                return;
+            // an empty chunk is all air, give it voxels to edit
+            data = {};
+            data.sector = sector;
+            data.resize(globals::ChunkSize);
+            data.empty = false;
         }
+        const glm::ivec3 local_cell = world_cell - sector * chunk_size;
+        const uint32_t idx = local_cell.x + local_cell.z * chunk_size + local_cell.y * chunk_size * chunk_size;
+        data.set_type(idx, block.type);
+        data.set_face_mask(idx, block.face_mask);
+        data.set_touches_water(idx, block.water_mask != 0);
+        chunk->remesh = true;
     }
     void break_block(const glm::vec3& origin, const glm::vec3& direction) noexcept
     {
@@ -1,5 +1,6 @@
 module;
 #include <array>
+#include <cstdint>
 
 export module ce.app:frustum;
 import glm;
@@ -96,6 +97,8 @@ public:
         return true; // Box is visible
     }
 
+    [[nodiscard]] const std::array<Plane, 6>& planes() const noexcept { return m_planes; }
+
 private:
     std::array<Plane, 6> m_planes;
 };
@@ -11,11 +11,22 @@ export namespace ce::app::globals
 bool headless = false;
 bool server_mode = false;
 bool xrmode = false;
+// Number of chunk generation workers, 0 uses all the cores but one
+uint32_t generate_workers = 0;
+// Bytes of chunk meshes copied to the GPU per frame, bursts are spread over the next frames
+uint32_t upload_budget = 4 << 20;
+// Lets the ring governor move the streamed rings with the frame cost, off keeps MaxChunkRings
+bool ring_governor = true;
+// Frame time in ms the ring governor aims for, 0 picks 90 Hz in xr and 60 Hz otherwise
+float frame_budget = 0;
 ma_engine audio_engine{};
 std::shared_ptr<resources::VulkanResources> m_resources;
 // Size of a block in meters
 constexpr float BlockSize = 0.5f;
 // Number of blocks per chunk
 constexpr uint32_t ChunkSize = 32;
-constexpr uint32_t ChunkRings = 4;
+// Most rings of chunks around the camera, sizes the chunk grid and the GPU buffers
+constexpr uint32_t MaxChunkRings = 4;
+// Fewest rings the governor drops to, the camera's neighbours are always resident for physics
+constexpr uint32_t MinChunkRings = 2;
 }
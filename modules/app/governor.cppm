@@ -0,0 +1,168 @@
+module;
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <volk.h>
+#include <tracy/Tracy.hpp>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "ChoppyEngine", __VA_ARGS__)
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, "ChoppyEngine", __VA_ARGS__)
+#else
+#define LOGE(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+#define LOGI(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+#endif
+
+export module ce.app:governor;
+import ce.vk;
+import ce.vk.utils;
+import :globals;
+
+export namespace ce::app::governor
+{
+// GPU time of each frame from a pair of timestamps around its commands. There's a pair per
+// frame in flight, read back without waiting when the frame comes around again.
+class GpuTimer final
+{
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueryPool m_pool = VK_NULL_HANDLE;
+    // nanoseconds per tick
+    float m_period = 0;
+    std::vector<bool> m_written;
+public:
+    bool create(const std::shared_ptr<vk::Context>& vk, const uint32_t frames) noexcept
+    {
+        const auto& limits = vk->physical_device_limits();
+        if (!limits.timestampComputeAndGraphics)
+        {
+            LOGI("timestamps not supported, the ring governor only sees the CPU time");
+            return true;
+        }
+        m_device = vk->device();
+        m_period = limits.timestampPeriod;
+        const VkQueryPoolCreateInfo info{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = frames * 2,
+        };
+        if (const VkResult result = vkCreateQueryPool(m_device, &info, nullptr, &m_pool); result != VK_SUCCESS)
+        {
+            LOGE("Failed to create the frame timestamps query pool: %s", vk::utils::to_string(result));
+            return false;
+        }
+        vk->debug_name("frame_timestamps", m_pool);
+        m_written.assign(frames, false);
+        return true;
+    }
+    void destroy() noexcept
+    {
+        if (m_pool)
+            vkDestroyQueryPool(m_device, m_pool, nullptr);
+        m_pool = VK_NULL_HANDLE;
+    }
+    // ms the last frame recorded in slot took on the GPU, nothing until it's done
+    [[nodiscard]] std::optional<float> read(const uint32_t slot) const noexcept
+    {
+        if (!m_pool || !m_written[slot])
+            return std::nullopt;
+        std::array<uint64_t, 2> ticks{};
+        if (vkGetQueryPoolResults(m_device, m_pool, slot * 2, 2, sizeof(ticks), ticks.data(),
+            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        {
+            return std::nullopt;
+        }
+        return static_cast<float>(ticks[1] - ticks[0]) * m_period * 1e-6f;
+    }
+    void begin(VkCommandBuffer cmd, const uint32_t slot) noexcept
+    {
+        if (!m_pool)
+            return;
+        vkCmdResetQueryPool(cmd, m_pool, slot * 2, 2);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_pool, slot * 2);
+    }
+    void end(VkCommandBuffer cmd, const uint32_t slot) noexcept
+    {
+        if (!m_pool)
+            return;
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_pool, slot * 2 + 1);
+        m_written[slot] = true;
+    }
+};
+struct FrameSample
+{
+    // main thread work of the frame, waits for the GPU and the display left out
+    float cpu_ms = 0;
+    std::optional<float> gpu_ms;
+    // share of the face buffer in use
+    float memory = 0;
+    // chunks of the current ring are still being generated or uploaded
+    bool streaming = false;
+};
+// Picks the chunk rings from the smoothed frame cost against the frame budget. A change
+// needs the cost past its threshold for a number of frames in a row, the thresholds to grow
+// and to shrink are far apart and every change is followed by a cooldown, so the ring
+// doesn't flip back and forth at the edge of the budget.
+class RingGovernor final
+{
+    float m_cpu_ms = 0;
+    float m_gpu_ms = 0;
+    uint32_t m_over = 0;
+    uint32_t m_under = 0;
+    uint32_t m_cooldown = 0;
+public:
+    // weight of a new sample in the running averages
+    static constexpr float Smoothing = 0.05f;
+    // share of the frame budget over which the ring shrinks and under which it grows
+    static constexpr float ShrinkLoad = 0.9f;
+    static constexpr float GrowLoad = 0.6f;
+    // share of the face buffer over which the ring shrinks and under which it may grow
+    static constexpr float ShrinkMemory = 0.9f;
+    static constexpr float GrowMemory = 0.7f;
+    // frames in a row past a threshold before the ring changes
+    static constexpr uint32_t ShrinkFrames = 30;
+    static constexpr uint32_t GrowFrames = 180;
+    // frames to let the averages settle after a change
+    static constexpr uint32_t CooldownFrames = 120;
+
+    [[nodiscard]] uint32_t update(const FrameSample& sample, const uint32_t rings, const float budget_ms) noexcept
+    {
+        m_cpu_ms += (sample.cpu_ms - m_cpu_ms) * Smoothing;
+        if (sample.gpu_ms)
+            m_gpu_ms += (*sample.gpu_ms - m_gpu_ms) * Smoothing;
+        TracyPlot("Frame CPU ms", m_cpu_ms);
+        TracyPlot("Frame GPU ms", m_gpu_ms);
+        TracyPlot("Chunk Rings", static_cast<int64_t>(rings));
+        if (m_cooldown > 0)
+        {
+            --m_cooldown;
+            return rings;
+        }
+        const float load = std::max(m_cpu_ms, m_gpu_ms) / budget_ms;
+        const bool over = load > ShrinkLoad || sample.memory > ShrinkMemory;
+        // a ring still filling in costs more once it's done
+        const bool under = load < GrowLoad && sample.memory < GrowMemory && !sample.streaming;
+        m_over = over ? m_over + 1 : 0;
+        m_under = under ? m_under + 1 : 0;
+        uint32_t next = rings;
+        if (m_over >= ShrinkFrames && rings > globals::MinChunkRings)
+            next = rings - 1;
+        else if (m_under >= GrowFrames && rings < globals::MaxChunkRings)
+            next = rings + 1;
+        if (next != rings)
+        {
+            LOGI("ring governor: cpu %.2f ms, gpu %.2f ms, memory %.0f%%, rings %u -> %u",
+                m_cpu_ms, m_gpu_ms, sample.memory * 100.f, rings, next);
+            m_over = 0;
+            m_under = 0;
+            m_cooldown = CooldownFrames;
+        }
+        return next;
+    }
+};
+}
@@ -10,7 +10,7 @@ export module ce.app:messages;
 import glm;
 import :serializer;
 
-namespace ce::app::messages
+export namespace ce::app::messages
 {
 enum class MessageType : uint16_t
 {
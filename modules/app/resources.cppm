@@ -1,9 +1,11 @@
 module;
+#include <algorithm>
 #include <ranges>
 #include <vector>
 #include <tuple>
 #include <memory>
 #include <map>
+#include <deque>
 #include <optional>
 #include <volk.h>
 #include <vk_mem_alloc.h>
@@ -30,6 +32,8 @@ import ce.vk.buffer;
 import ce.vk.texture;
 import ce.platform.globals;
 import ce.shaders.solidcolor;
+import ce.shaders.chunkcull;
+import ce.shaders.solidflat;
 import :utils;
 
 export namespace ce::app::resources
@@ -57,15 +61,105 @@ struct IndexedGeometry
     vk::BufferSuballocation uniform_buffer{};
     uint32_t indices_count = 0;
 };
+// Ring of staging space for streamed uploads, carved once out of the staging buffer so the
+// copies go through exec_copy_buffers like any other. Space is handed out linearly and
+// given back a frame at a time once the timeline passes the value the frame was tagged with.
+class StagingRing
+{
+    vk::BufferSuballocation m_region{};
+    VkDeviceSize m_head = 0;
+    // bytes between the oldest frame still in flight and m_head, wrap padding included
+    VkDeviceSize m_used = 0;
+    VkDeviceSize m_frame_bytes = 0;
+    // held back from alloc() for alloc_reserved(), see set_reserve
+    VkDeviceSize m_reserve = 0;
+    std::deque<std::pair<uint64_t, VkDeviceSize>> m_frames;
+
+    [[nodiscard]] std::optional<vk::BufferSuballocation> take(const VkDeviceSize size,
+        const VkDeviceSize alignment, const VkDeviceSize held) noexcept
+    {
+        if (m_used == 0)
+            m_head = 0;
+        VkDeviceSize offset = (m_head + alignment - 1) / alignment * alignment;
+        if (offset + size > m_region.size)
+            offset = 0;
+        // the padding skipped to align or to wrap counts as used until the frame is done
+        const VkDeviceSize consumed = (offset >= m_head ? offset - m_head : m_region.size - m_head) + size;
+        if (m_used + consumed + held > m_region.size)
+            return std::nullopt;
+        m_head = offset + size;
+        m_used += consumed;
+        m_frame_bytes += consumed;
+        return vk::BufferSuballocation{VK_NULL_HANDLE, m_region.offset + offset, size,
+            static_cast<uint8_t*>(m_region.ptr) + offset};
+    }
+
+public:
+    StagingRing() = default;
+    explicit StagingRing(const vk::BufferSuballocation& region) noexcept : m_region(region) { }
+    [[nodiscard]] const vk::BufferSuballocation& region() const noexcept { return m_region; }
+    [[nodiscard]] VkDeviceSize capacity() const noexcept { return m_region.size; }
+    [[nodiscard]] VkDeviceSize used() const noexcept { return m_used; }
+    // Keeps bytes of the ring out of reach of alloc(). alloc() never fills the ring past
+    // capacity - bytes, so up to bytes / 2 a frame taken with alloc_reserved(), wrap padding
+    // included, always fits however much the streaming asked for.
+    void set_reserve(const VkDeviceSize bytes) noexcept
+    {
+        m_reserve = std::min(bytes, m_region.size);
+    }
+    // The returned range is only valid until the frame it was allocated in completes
+    [[nodiscard]] std::optional<vk::BufferSuballocation> alloc(const VkDeviceSize size,
+        const VkDeviceSize alignment) noexcept
+    {
+        return take(size, alignment, m_reserve);
+    }
+    // Same as alloc() but may use the reserve, for the small per frame data that can't wait
+    [[nodiscard]] std::optional<vk::BufferSuballocation> alloc_reserved(const VkDeviceSize size,
+        const VkDeviceSize alignment) noexcept
+    {
+        return take(size, alignment, 0);
+    }
+    // Tags what the frame allocated with the timeline value signaled when it completes
+    void end_frame(const uint64_t timeline_value) noexcept
+    {
+        if (m_frame_bytes == 0)
+            return;
+        m_frames.emplace_back(timeline_value, m_frame_bytes);
+        m_frame_bytes = 0;
+    }
+    void reclaim(const uint64_t timeline_value) noexcept
+    {
+        while (!m_frames.empty() && timeline_value >= m_frames.front().first)
+        {
+            m_used -= m_frames.front().second;
+            m_frames.pop_front();
+        }
+    }
+};
 struct VulkanResources : utils::NoCopy
 {
+    // Chunk grid slots the culling pass reads a record for, and the draws it can emit per layer,
+    // at most three runs of visible directions per chunk
+    static constexpr uint32_t MaxChunkSlots = 4096;
+    static constexpr uint32_t MaxChunkDraws = MaxChunkSlots * 3;
     std::multimap<uint64_t, std::pair<vk::Buffer&, const vk::BufferSuballocation>> delete_buffers;
     std::vector<std::tuple<vk::Buffer&, const vk::BufferSuballocation, VkDeviceSize /*dst_offset*/>> copy_buffers;
+    // ranges relocated inside the same buffer, recorded before copy_buffers
+    std::vector<std::tuple<vk::Buffer&, const vk::BufferSuballocation, VkDeviceSize /*dst_offset*/>> move_buffers;
     vk::Buffer staging_buffer;
+    StagingRing upload_ring;
+    // bytes recorded by the last exec_copy_buffers
+    VkDeviceSize copied_bytes = 0;
     vk::Buffer vertex_buffer;
+    vk::Buffer face_buffer;
     vk::Buffer frame_buffer;
     vk::Buffer object_buffer;
+    // per chunk grid slot, rewritten when the chunk in the slot changes
+    vk::Buffer cull_buffer;
+    vk::Buffer chunk_object_buffer;
+    // written by the chunk culling pass, see ChunkCullShader
     vk::Buffer args_buffer;
+    vk::Buffer draw_count_buffer;
     vk::texture::Texture texture;
     vk::texture::Texture texture_array;
     VkSampler sampler = VK_NULL_HANDLE;
@@ -73,12 +167,23 @@ struct VulkanResources : utils::NoCopy
     {
         ZoneScoped;
         // Create and upload vertex buffer
-        vertex_buffer = vk::Buffer(vk, "ChunksVertexBuffer");
-        if (!vertex_buffer.create(1024 * (1 << 20),
+        vertex_buffer = vk::Buffer(vk, "GeometryVertexBuffer");
+        if (!vertex_buffer.create(64 * (1 << 20),
             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
             VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE))
         {
-            LOGE("Failed to create chunks vertex buffer");
+            LOGE("Failed to create geometry vertex buffer");
+            return false;
+        }
+
+        // Chunk face records, 8 bytes per quad pulled by the solid-flat vertex shader.
+        // Bound whole as a storage buffer, 128 MiB is the guaranteed maxStorageBufferRange.
+        face_buffer = vk::Buffer(vk, "ChunksFaceBuffer");
+        if (!face_buffer.create(128 * (1 << 20),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE))
+        {
+            LOGE("Failed to create chunks face buffer");
             return false;
         }
 
@@ -108,25 +213,67 @@ struct VulkanResources : utils::NoCopy
             LOGE("Failed to create cube vertex buffer");
             return false;
         }
+        // chunk meshes stream through their own ring instead of fragmenting the staging block
+        if (const auto region = staging_buffer.suballoc(32 * (1 << 20), 256))
+        {
+            upload_ring = StagingRing(*region);
+        }
+        else
+        {
+            LOGE("Failed to create upload ring");
+            return false;
+        }
 
-        args_buffer = vk::Buffer(vk, "CubeArgsBuffer");
-        constexpr uint32_t args_buffer_size = sizeof(VkDrawIndirectCommand) * 30'000;
-        if (!args_buffer.create(args_buffer_size,
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        using ChunkCull = shaders::ChunkCullShader;
+        cull_buffer = vk::Buffer(vk, "ChunksCullBuffer");
+        if (!cull_buffer.create(sizeof(ChunkCull::ChunkCullInput) * MaxChunkSlots,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
             VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE))
         {
-            LOGE("Failed to create cube vertex buffer");
+            LOGE("Failed to create chunks cull buffer");
+            return false;
+        }
+        chunk_object_buffer = vk::Buffer(vk, "ChunksObjectBuffer");
+        if (!chunk_object_buffer.create(sizeof(shaders::SolidFlatShader::PerObjectBuffer) * MaxChunkSlots,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE))
+        {
+            LOGE("Failed to create chunks object buffer");
+            return false;
+        }
+
+        // per layer regions of MaxChunkDraws
+        args_buffer = vk::Buffer(vk, "ChunksDrawArgsBuffer");
+        if (!args_buffer.create(sizeof(VkDrawIndirectCommand) * MaxChunkDraws * ChunkCull::CullLayers,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE))
+        {
+            LOGE("Failed to create chunks draw args buffer");
+            return false;
+        }
+        draw_count_buffer = vk::Buffer(vk, "ChunksDrawCountBuffer");
+        if (!draw_count_buffer.create(sizeof(uint32_t) * ChunkCull::CullLayers,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE))
+        {
+            LOGE("Failed to create chunks draw count buffer");
             return false;
         }
         return true;
     }
     void destroy_buffers() noexcept
     {
+        staging_buffer.subfree(upload_ring.region());
+        upload_ring = {};
         staging_buffer.destroy();
         vertex_buffer.destroy();
+        face_buffer.destroy();
         frame_buffer.destroy();
         object_buffer.destroy();
+        cull_buffer.destroy();
+        chunk_object_buffer.destroy();
         args_buffer.destroy();
+        draw_count_buffer.destroy();
     }
     void garbage_collect(const uint64_t timeline_value) noexcept
     {
@@ -147,6 +294,7 @@ struct VulkanResources : utils::NoCopy
             }
         }
         delete_buffers = std::move(not_deleted);
+        upload_ring.reclaim(timeline_value);
     }
     template<typename ShaderType>
     [[nodiscard]] Geometry create_cube() noexcept
@@ -299,11 +447,37 @@ struct VulkanResources : utils::NoCopy
     void exec_copy_buffers(VkCommandBuffer cmd) noexcept
     {
         ZoneScoped;
+        copied_bytes = 0;
+        // chunk records and objects are rewritten in place, the previous frame may still read them
+        if (!copy_buffers.empty())
+        {
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+        }
+        if (!move_buffers.empty())
+        {
+            // the sources may have been written by the copies of earlier frames
+            constexpr VkMemoryBarrier barrier{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            };
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                1, &barrier, 0, nullptr, 0, nullptr);
+            for (auto& [buffer, sb, dst_offset] : move_buffers)
+            {
+                buffer.copy_from(cmd, buffer.buffer(), sb, dst_offset);
+                copied_bytes += sb.size;
+            }
+            move_buffers.clear();
+        }
         for (auto& [buffer, sb, dst_offset] : copy_buffers)
         {
             buffer.copy_from(cmd, staging_buffer.buffer(), sb, dst_offset);
+            copied_bytes += sb.size;
         }
         copy_buffers.clear();
+        TracyPlot("Copied Bytes", static_cast<int64_t>(copied_bytes));
     }
 };
 // void Geometry::destroy() noexcept
@@ -8,6 +8,7 @@ import ce.vk.shader;
 import ce.shaders.solidcolor;
 import ce.shaders.solidflat;
 import ce.shaders.textured;
+import ce.shaders.chunkcull;
 
 export namespace ce::shaders
 {
@@ -15,6 +16,7 @@ std::shared_ptr<SolidFlatShader> shader_opaque;
 std::shared_ptr<SolidFlatShader> shader_transparent;
 std::shared_ptr<SolidColorShader> shader_color;
 std::shared_ptr<TexturedShader> shader_textured;
+std::shared_ptr<ChunkCullShader> shader_cull;
 
 struct ShadersCreateInfo
 {
@@ -28,11 +30,13 @@ bool create_shaders(const ShadersCreateInfo& info) noexcept
     shader_opaque = std::make_shared<SolidFlatShader>(info.vk, "Opaque");
     shader_opaque->create(info.renderpass, info.swapchain_count, info.sample_count, 1, 100, false, false);
     shader_transparent = std::make_shared<SolidFlatShader>(info.vk, "Transparent");
-    shader_transparent->create(info.renderpass, info.swapchain_count, info.sample_count, 1, 100, true, true);
+    shader_transparent->create(info.renderpass, info.swapchain_count, info.sample_count, 1, 100, true, true, -0.1f);
     shader_color = std::make_shared<SolidColorShader>(info.vk, "Color");
     shader_color->create(info.renderpass, info.swapchain_count, info.sample_count, 1, 100, true, true, true);
     shader_textured = std::make_shared<TexturedShader>(info.vk, "Textured");
     shader_textured->create(info.renderpass, info.swapchain_count, info.sample_count, 1, 100, 100, false, false, false);
+    shader_cull = std::make_shared<ChunkCullShader>(info.vk, "Chunks");
+    shader_cull->create(info.swapchain_count, 1);
     return true;
 }
 void destroy_shaders() noexcept
@@ -41,6 +45,7 @@ void destroy_shaders() noexcept
     shader_transparent.reset();
     shader_color.reset();
     shader_textured.reset();
+    shader_cull.reset();
 }
 void reset_descriptors(uint32_t present_index) noexcept
 {
@@ -48,6 +53,7 @@ void reset_descriptors(uint32_t present_index) noexcept
     shader_transparent->reset_descriptors(present_index);
     shader_color->reset_descriptors(present_index);
     shader_textured->reset_descriptors(present_index);
+    shader_cull->reset_descriptors(present_index);
 }
 void update_descriptors() noexcept
 {
@@ -55,5 +61,6 @@ void update_descriptors() noexcept
     shader_transparent->update_descriptors();
     shader_color->update_descriptors();
     shader_textured->update_descriptors();
+    shader_cull->update_descriptors();
 }
 }
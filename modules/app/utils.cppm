@@ -5,6 +5,8 @@ module;
 #include <vector>
 #include <cstddef>
 #include <numeric>
+#include <atomic>
+#include <utility>
 export module ce.app:utils;
 import glm;
 
@@ -60,6 +62,55 @@ auto sorted_view(R& r, Comp comp = {}, Proj proj = {})
             return *(begin(*ptr) + i);
         });
 }
+// Multiple producer, single consumer handoff. Producers link their node in front of the
+// head with a CAS, the consumer takes the whole list with one exchange and reverses it,
+// so there's no pop of single nodes and no ABA to deal with.
+template <typename T>
+class MpscQueue
+{
+    struct Node
+    {
+        T value;
+        Node* next = nullptr;
+    };
+    std::atomic<Node*> m_head = nullptr;
+
+public:
+    MpscQueue() = default;
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+    ~MpscQueue() noexcept
+    {
+        Node* node = m_head.exchange(nullptr);
+        while (node)
+            delete std::exchange(node, node->next);
+    }
+    void push(T&& value) noexcept
+    {
+        Node* node = new Node{std::move(value)};
+        node->next = m_head.load(std::memory_order_relaxed);
+        while (!m_head.compare_exchange_weak(node->next, node,
+            std::memory_order_release, std::memory_order_relaxed)) { }
+    }
+    // Appends everything pushed so far to out, oldest first, never blocks
+    void drain(auto& out) noexcept
+    {
+        Node* reversed = nullptr;
+        Node* node = m_head.exchange(nullptr, std::memory_order_acquire);
+        while (node)
+        {
+            Node* next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+        while (reversed)
+        {
+            out.emplace_back(std::move(reversed->value));
+            delete std::exchange(reversed, reversed->next);
+        }
+    }
+};
 [[nodiscard]] std::vector<std::tuple<glm::ivec3, float, glm::ivec3>> traverse_3d_dda(const glm::vec3& origin,
     const glm::vec3& direction, const glm::vec3& grid_origin_reference, const float max_t, const float BlockSize) noexcept
 {
@@ -44,6 +44,7 @@ import ce.vk.shader;
 import ce.vk.utils;
 import ce.shaders.solidflat;
 import ce.shaders.solidcolor;
+import ce.shaders.chunkcull;
 import glm;
 import :utils;
 import :frustum;
@@ -78,6 +79,7 @@ struct World
     VkDescriptorSet shader_color_frame_set = VK_NULL_HANDLE;
     VkDescriptorSet shader_textured_frame_set = VK_NULL_HANDLE;
     VkDescriptorSet shader_textured_material_set = VK_NULL_HANDLE;
+    VkDescriptorSet shader_cull_set = VK_NULL_HANDLE;
 
     chunksman::ChunksManager chunks_manager;
 
@@ -212,6 +214,7 @@ struct World
     {
         m_camera.cam_forward = glm::vec4{0, 0, -1, 1} * view;
         chunks_manager.cam_pos = m_camera.cam_pos;
+        chunks_manager.cam_velocity = glm::gtc::make_vec3(m_player.character->GetLinearVelocity().mF32);
         //chunks_manager.cam_sector = m_camera.cam_sector;
         chunks_manager.update_chunks(frame);
 
@@ -315,15 +318,36 @@ struct World
             }
         }
 
-        for (auto& [k, state] : chunks_manager.m_chunks_state)
+        // draws pick their chunk's object with firstInstance
+        for (size_t l = 0; l < BlockLayerCount; ++l)
         {
-            const auto& shader = (k == BlockLayer::Transparent) ? shaders::shader_transparent : shaders::shader_opaque;
+            auto& state = chunks_manager.m_chunks_state[l];
+            const auto& shader = (static_cast<BlockLayer>(l) == BlockLayer::Transparent) ?
+                shaders::shader_transparent : shaders::shader_opaque;
+            state.object_descriptor_set = VK_NULL_HANDLE;
             if (const auto set = shader->alloc_descriptor(frame.present_index, 1))
             {
                 state.object_descriptor_set = *set;
-                shader->write_buffer(*set, 0, globals::m_resources->object_buffer.buffer(),
-                    state.uniform_buffer.offset, state.uniform_buffer.size,
-                    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+                shader->write_buffer(*set, 0, globals::m_resources->chunk_object_buffer.buffer(),
+                    0, VK_WHOLE_SIZE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+                shader->write_buffer(*set, 1, globals::m_resources->face_buffer.buffer(),
+                    0, VK_WHOLE_SIZE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            }
+        }
+        shader_cull_set = VK_NULL_HANDLE;
+        if (const auto& constants = chunks_manager.m_cull_constants; constants.alloc)
+        {
+            if (const auto set = shaders::shader_cull->alloc_descriptor(frame.present_index, 0))
+            {
+                shader_cull_set = *set;
+                shaders::shader_cull->write_buffer(*set, 0, globals::m_resources->frame_buffer.buffer(),
+                    constants.offset, constants.size, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+                shaders::shader_cull->write_buffer(*set, 1, globals::m_resources->cull_buffer.buffer(),
+                    0, VK_WHOLE_SIZE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+                shaders::shader_cull->write_buffer(*set, 2, globals::m_resources->args_buffer.buffer(),
+                    0, VK_WHOLE_SIZE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+                shaders::shader_cull->write_buffer(*set, 3, globals::m_resources->draw_count_buffer.buffer(),
+                    0, VK_WHOLE_SIZE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             }
         }
 
@@ -563,34 +587,81 @@ struct World
             }
         }
     }
+    // Culls the chunk records and writes the draws of each layer, recorded after the copies
+    // and before the render pass
+    void cull(VkCommandBuffer cmd) noexcept
+    {
+        const auto& res = *globals::m_resources;
+        // the previous frame's draws are done reading what gets rewritten here
+        const VkMemoryBarrier draws_read{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &draws_read, 0, nullptr, 0, nullptr);
+        vkCmdFillBuffer(cmd, res.draw_count_buffer.buffer(), 0, VK_WHOLE_SIZE, 0);
+        // without a draw count every command is issued, the unused ones have to draw nothing
+        if (!m_vk->draw_indirect_count())
+            vkCmdFillBuffer(cmd, res.args_buffer.buffer(), 0, VK_WHOLE_SIZE, 0);
+        const VkMemoryBarrier cleared{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &cleared, 0, nullptr, 0, nullptr);
+        // no constants this frame, nothing is drawn
+        if (shader_cull_set != VK_NULL_HANDLE)
+        {
+            using ChunkCull = shaders::ChunkCullShader;
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, shaders::shader_cull->pipeline());
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                shaders::shader_cull->layout(), 0, 1, &shader_cull_set, 0, nullptr);
+            vkCmdDispatch(cmd, (chunksman::ChunkGrid::Slots + ChunkCull::CullThreads - 1) / ChunkCull::CullThreads, 1, 1);
+        }
+        const VkMemoryBarrier culled{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+            0, 1, &culled, 0, nullptr, 0, nullptr);
+    }
     void render(const float dt, VkCommandBuffer cmd) noexcept
     {
-        if (chunks_manager.m_chunks_state.size() > 0)
         {
-            std::vector<std::pair<std::shared_ptr<vk::ShaderModule>, chunksman::ChunksState>> layers{};
-            if (chunks_manager.m_chunks_state.contains(BlockLayer::Solid))
-            {
-                layers.emplace_back(shaders::shader_opaque, chunks_manager.m_chunks_state[BlockLayer::Solid]);
-            }
-            if (chunks_manager.m_chunks_state.contains(BlockLayer::Transparent))
-            {
-                layers.emplace_back(shaders::shader_transparent, chunks_manager.m_chunks_state[BlockLayer::Transparent]);
-            }
-            for (const auto& [shader, state] : layers)
+            constexpr uint32_t max_draws = resources::VulkanResources::MaxChunkDraws;
+            const std::array layers{
+                std::pair(shaders::shader_opaque, BlockLayer::Solid),
+                std::pair(shaders::shader_transparent, BlockLayer::Transparent),
+            };
+            for (const auto& [shader, layer] : layers)
             {
+                const auto l = static_cast<size_t>(layer);
+                const auto& state = chunks_manager.m_chunks_state[l];
+                if (state.object_descriptor_set == VK_NULL_HANDLE)
+                    continue;
                 vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shader->pipeline());
 
-                const std::array vertex_buffers{globals::m_resources->vertex_buffer.buffer()};
-                const std::array vertex_buffers_offset{VkDeviceSize{0ull}};
-                vkCmdBindVertexBuffers(cmd, 0, static_cast<uint32_t>(vertex_buffers.size()),
-                    vertex_buffers.data(), vertex_buffers_offset.data());
-
                 const std::array sets{shader_flat_frame_set, state.object_descriptor_set};
                 vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
                     shader->layout(), 0, sets.size(), sets.data(), 0, nullptr);
 
-                vkCmdDrawIndirect(cmd, globals::m_resources->args_buffer.buffer(),
-                    state.args_buffer.offset, state.draw_count, sizeof(VkDrawIndirectCommand));
+                const VkDeviceSize args_offset = l * max_draws * sizeof(VkDrawIndirectCommand);
+                if (m_vk->draw_indirect_count())
+                {
+                    vkCmdDrawIndirectCountKHR(cmd, globals::m_resources->args_buffer.buffer(), args_offset,
+                        globals::m_resources->draw_count_buffer.buffer(), l * sizeof(uint32_t),
+                        max_draws, sizeof(VkDrawIndirectCommand));
+                }
+                else
+                {
+                    vkCmdDrawIndirect(cmd, globals::m_resources->args_buffer.buffer(), args_offset,
+                        max_draws, sizeof(VkDrawIndirectCommand));
+                }
             }
         }
 
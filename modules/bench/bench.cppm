@@ -0,0 +1,961 @@
+module;
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <type_traits>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <PerlinNoise.hpp>
+#include <nlohmann/json.hpp>
+#include <Jolt/Jolt.h>
+#include <Jolt/Physics/Body/BodyID.h>
+#include <Jolt/Core/Reference.h>
+#include <Jolt/Physics/Collision/Shape/Shape.h>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "ChoppyEngine", __VA_ARGS__)
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, "ChoppyEngine", __VA_ARGS__)
+#else
+#define LOGE(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+#define LOGI(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+#endif
+
+export module ce.app.bench;
+import glm;
+import ce.app;
+import ce.shaders.solidflat;
+import ce.shaders.chunkcull;
+import ce.vk;
+import ce.vk.buffer;
+import ce.vk.utils;
+
+export namespace ce::app::bench
+{
+// Bumped by the allocation hooks of the bench executable
+std::atomic_uint64_t allocated_bytes{0};
+std::atomic_uint64_t allocation_count{0};
+
+struct Result
+{
+    std::string name;
+    uint64_t iterations = 0;
+    double ns_per_op = 0;
+    double bytes_per_op = 0;
+    double allocs_per_op = 0;
+};
+struct Check
+{
+    std::string name;
+    bool passed = false;
+    double max_error = 0;
+};
+
+// Fixed seed microbenchmarks of the voxel pipeline. Each case runs until
+// min_time has passed, reports ns/op and the heap traffic per op.
+class Runner
+{
+    std::vector<Result> m_results;
+    std::vector<Check> m_checks;
+    std::string m_filter;
+    std::chrono::milliseconds m_min_time{200};
+    // results are folded in here so the optimizer can't drop the work
+    volatile uint64_t m_sink = 0;
+public:
+    Runner(std::string filter, const std::chrono::milliseconds min_time) noexcept
+        : m_filter(std::move(filter)), m_min_time(min_time) { }
+    template<typename T>
+    void sink(const T value) noexcept
+    {
+        if constexpr (std::is_floating_point_v<T>)
+            m_sink = m_sink + std::bit_cast<uint64_t>(static_cast<double>(value));
+        else
+            m_sink = m_sink + static_cast<uint64_t>(value);
+    }
+    template<typename F>
+    void run(const std::string& name, F&& fn) noexcept
+    {
+        if (!m_filter.empty() && !name.contains(m_filter))
+            return;
+        // warm up caches and lazy allocations
+        fn();
+        using clock = std::chrono::steady_clock;
+        const uint64_t bytes_start = allocated_bytes.load();
+        const uint64_t allocs_start = allocation_count.load();
+        const auto start = clock::now();
+        uint64_t iterations = 0;
+        auto elapsed = clock::duration{};
+        do
+        {
+            fn();
+            ++iterations;
+            elapsed = clock::now() - start;
+        } while (elapsed < m_min_time || iterations < 3);
+        const Result result{
+            .name = name,
+            .iterations = iterations,
+            .ns_per_op = std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+            .bytes_per_op = static_cast<double>(allocated_bytes.load() - bytes_start) / iterations,
+            .allocs_per_op = static_cast<double>(allocation_count.load() - allocs_start) / iterations,
+        };
+        LOGI("%-36s %14.1f ns/op %12.1f B/op %9.1f allocs/op", result.name.c_str(),
+            result.ns_per_op, result.bytes_per_op, result.allocs_per_op);
+        m_results.push_back(result);
+    }
+    void check(const std::string& name, const bool passed, const double max_error) noexcept
+    {
+        LOGI("%-36s %s (max error %g)", name.c_str(), passed ? "passed" : "FAILED", max_error);
+        m_checks.push_back({name, passed, max_error});
+    }
+    [[nodiscard]] bool passed() const noexcept
+    {
+        return std::ranges::all_of(m_checks, &Check::passed);
+    }
+    [[nodiscard]] nlohmann::json to_json() const noexcept
+    {
+        nlohmann::json j;
+        j["noise_backend"] = BatchNoise::backend();
+        j["results"] = nlohmann::json::array();
+        for (const auto& r : m_results)
+        {
+            j["results"].push_back({
+                {"name", r.name},
+                {"iterations", r.iterations},
+                {"ns_per_op", r.ns_per_op},
+                {"bytes_per_op", r.bytes_per_op},
+                {"allocs_per_op", r.allocs_per_op},
+            });
+        }
+        j["checks"] = nlohmann::json::array();
+        for (const auto& c : m_checks)
+            j["checks"].push_back({{"name", c.name}, {"passed", c.passed}, {"max_error", c.max_error}});
+        return j;
+    }
+};
+
+// Builds chunk voxels from a function over world cells, neighbours outside the chunk included
+[[nodiscard]] ChunkData make_chunk(const std::function<BlockType(const glm::ivec3&)>& fn) noexcept
+{
+    constexpr int32_t size = globals::ChunkSize;
+    ChunkData data;
+    data.resize(size);
+    data.empty = false;
+    std::vector<BlockType> types(utils::pow(size, 3));
+    for (int32_t y = 0; y < size; ++y)
+        for (int32_t z = 0; z < size; ++z)
+            for (int32_t x = 0; x < size; ++x)
+                types[x + z * size + y * size * size] = fn({x, y, z});
+    data.assign(types);
+    for (int32_t y = 0; y < size; ++y)
+    {
+        for (int32_t z = 0; z < size; ++z)
+        {
+            for (int32_t x = 0; x < size; ++x)
+            {
+                const glm::ivec3 c{x, y, z};
+                const Block b = FlatGenerator::make_block(fn(c), {
+                    fn(c + glm::ivec3(0, 1, 0)), fn(c + glm::ivec3(0, -1, 0)),
+                    fn(c + glm::ivec3(0, 0, 1)), fn(c + glm::ivec3(0, 0, -1)),
+                    fn(c + glm::ivec3(-1, 0, 0)), fn(c + glm::ivec3(1, 0, 0))});
+                const uint32_t idx = x + z * size + y * size * size;
+                data.set_face_mask(idx, b.face_mask);
+                data.set_touches_water(idx, b.water_mask != 0);
+            }
+        }
+    }
+    return data;
+}
+
+void check_noise(Runner& runner) noexcept
+{
+    const siv::PerlinNoise perlin{1};
+    const BatchNoise noise{perlin.serialize()};
+    std::mt19937 rng{1};
+    std::uniform_real_distribution<double> dist(-500.0, 500.0);
+    std::vector<double> x(4099), y(4099), batch(4099), octaves(4099);
+    for (size_t i = 0; i < x.size(); ++i)
+    {
+        x[i] = dist(rng);
+        y[i] = dist(rng);
+    }
+    noise.noise2D(x, y, batch);
+    noise.octave2D(x, y, octaves, 4);
+    // the terrain height floors the noise, any difference can move a block
+    double max_error = 0;
+    double max_error_siv = 0;
+    for (size_t i = 0; i < x.size(); ++i)
+    {
+        max_error = std::max(max_error, std::abs(batch[i] - noise.noise2D(x[i], y[i])));
+        max_error = std::max(max_error, std::abs(octaves[i] - noise.octave2D(x[i], y[i], 4)));
+        max_error_siv = std::max(max_error_siv, std::abs(batch[i] - perlin.noise2D(x[i], y[i])));
+        max_error_siv = std::max(max_error_siv, std::abs(octaves[i] - perlin.octave2D(x[i], y[i], 4)));
+    }
+    runner.check("noise/batch_vs_single", max_error == 0, max_error);
+    runner.check("noise/batch_vs_siv", max_error_siv == 0, max_error_siv);
+}
+
+void check_peek(Runner& runner) noexcept
+{
+    const FlatGenerator generator{globals::ChunkSize, 10};
+    const int32_t ssz = static_cast<int32_t>(globals::ChunkSize);
+    double mismatches = 0;
+    for (int32_t sy = -2; sy <= 1; ++sy)
+    {
+        for (int32_t sz = -2; sz <= 2; ++sz)
+        {
+            for (int32_t sx = -2; sx <= 2; ++sx)
+            {
+                const glm::ivec3 sector{sx, sy, sz};
+                const ChunkData data = generator.generate(sector, 1);
+                for (int32_t y = 0; y < ssz; ++y)
+                {
+                    for (int32_t z = 0; z < ssz; ++z)
+                    {
+                        for (int32_t x = 0; x < ssz; ++x)
+                        {
+                            const BlockType peeked = generator.peek(sector * ssz + glm::ivec3(x, y, z));
+                            // buried chunks don't store their types, only that none of them is air
+                            const bool same = data.solid ? peeked != BlockType::Air :
+                                data.empty ? peeked == BlockType::Air :
+                                data.type(glm::uvec3(x, y, z)) == peeked;
+                            mismatches += same ? 0 : 1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    runner.check("generate/peek_vs_generate", mismatches == 0, mismatches);
+}
+
+void bench_noise(Runner& runner) noexcept
+{
+    const siv::PerlinNoise perlin{1};
+    const BatchNoise noise{perlin.serialize()};
+    std::vector<double> x(34), y(34, 0.25), out(34);
+    for (size_t i = 0; i < x.size(); ++i)
+        x[i] = static_cast<double>(i) / globals::ChunkSize;
+    runner.run("noise/octave2D_row_siv", [&]
+    {
+        for (size_t i = 0; i < x.size(); ++i)
+            out[i] = perlin.octave2D(x[i], y[i], 4);
+        runner.sink(out[7]);
+    });
+    runner.run("noise/octave2D_row_batch", [&]
+    {
+        noise.octave2D(x, y, out, 4);
+        runner.sink(out[7]);
+    });
+}
+
+void bench_generate(Runner& runner) noexcept
+{
+    const FlatGenerator generator{globals::ChunkSize, 10};
+    // a ring of sectors around the surface, some of them empty or buried
+    std::vector<glm::ivec3> sectors;
+    for (int32_t y = -2; y <= 1; ++y)
+        for (int32_t z = -2; z <= 2; ++z)
+            for (int32_t x = -2; x <= 2; ++x)
+                sectors.emplace_back(x, y, z);
+    for (const uint32_t lod : {1u, 2u, 4u, 8u})
+    {
+        size_t i = 0;
+        runner.run(std::format("generate/lod{}", lod), [&]
+        {
+            const ChunkData data = generator.generate(sectors[i++ % sectors.size()], lod);
+            runner.sink(data.palette.size());
+        });
+    }
+    runner.run("generate/surface_lod1", [&]
+    {
+        const ChunkData data = generator.generate({0, 0, 0}, 1);
+        runner.sink(data.palette.size());
+    });
+}
+
+[[nodiscard]] ChunkData hilly_chunk() noexcept
+{
+    const FlatGenerator generator{globals::ChunkSize, 10};
+    for (const glm::ivec3 sector : {glm::ivec3(0, 0, 0), glm::ivec3(0, -1, 0), glm::ivec3(1, 0, 0)})
+    {
+        if (ChunkData data = generator.generate(sector, 1); !data.empty && !data.solid)
+            return data;
+    }
+    return make_chunk([&generator](const glm::ivec3& c){ return generator.peek(c); });
+}
+
+// Face records of a mesh sorted, the meshers may emit them in any order
+template<typename T>
+[[nodiscard]] std::vector<std::pair<size_t, uint64_t>> sorted_faces(const ChunkMesher<T>& mesher,
+    const ChunkData& data) noexcept
+{
+    LayerMeshes<T> meshes;
+    mesher.mesh(data, globals::BlockSize, 1, meshes);
+    std::vector<std::pair<size_t, uint64_t>> faces;
+    for (size_t layer = 0; layer < meshes.size(); ++layer)
+    {
+        for (const auto& f : meshes[layer].faces)
+            faces.emplace_back(layer, (static_cast<uint64_t>(f.data_ext) << 32) | f.data);
+    }
+    std::ranges::sort(faces);
+    return faces;
+}
+
+// Records in one sorted list and not in the other
+template<typename R>
+[[nodiscard]] double mismatched(const std::vector<R>& a, const std::vector<R>& b) noexcept
+{
+    std::vector<R> diff;
+    std::ranges::set_symmetric_difference(a, b, std::back_inserter(diff));
+    return static_cast<double>(diff.size());
+}
+
+// Unit face record: [8b BlockLayer | 24b face ext | 32b packed 1x1 quad]
+[[nodiscard]] uint64_t unit_face(const size_t layer, const uint32_t ext, const glm::uvec3& pos) noexcept
+{
+    return (static_cast<uint64_t>(layer) << 56) | (static_cast<uint64_t>(ext) << 32) | pack_face(pos, {1, 1});
+}
+
+// Every quad of a mesh split back into the unit faces it covers, sorted
+template<typename T>
+[[nodiscard]] std::vector<uint64_t> unit_faces(const LayerMeshes<T>& meshes) noexcept
+{
+    std::vector<uint64_t> faces;
+    for (size_t layer = 0; layer < meshes.size(); ++layer)
+    {
+        for (const auto& f : meshes[layer].faces)
+        {
+            const MeshSlice& s = MeshSlices[f.data_ext & 0x07];
+            const glm::uvec3 pos{f.data & 0x3F, (f.data >> 6) & 0x3F, (f.data >> 12) & 0x3F};
+            const uint32_t w = (f.data >> 18) & 0x3F;
+            const uint32_t h = (f.data >> 24) & 0x3F;
+            for (uint32_t v = 0; v < h; ++v)
+            {
+                for (uint32_t u = 0; u < w; ++u)
+                {
+                    glm::uvec3 cell = pos;
+                    cell[s.u_comp] += u;
+                    cell[s.v_comp] += v;
+                    faces.push_back(unit_face(layer, f.data_ext, cell));
+                }
+            }
+        }
+    }
+    std::ranges::sort(faces);
+    return faces;
+}
+
+// The unmerged faces of every block, one by one from its type and face bits. Shares
+// nothing with the meshers but the record layout, so it can tell them apart.
+[[nodiscard]] std::vector<uint64_t> reference_unit_faces(const ChunkData& data) noexcept
+{
+    std::vector<uint64_t> faces;
+    if (data.empty || data.solid)
+        return faces;
+    const uint32_t size = data.size;
+    for (uint32_t face_index = 0; face_index < MeshSlices.size(); ++face_index)
+    {
+        const MeshSlice& s = MeshSlices[face_index];
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t z = 0; z < size; ++z)
+            {
+                for (uint32_t x = 0; x < size; ++x)
+                {
+                    const glm::uvec3 cell{x, y, z};
+                    const uint32_t idx = x + z * size + y * size * size;
+                    const BlockType type = data.type(idx);
+                    if (type == BlockType::Air || !data.face(face_index, idx))
+                        continue;
+                    const uint32_t key = face_key(data, material(type), cell, idx, face_index);
+                    // the faces looking down an axis sit on the far side of their cell
+                    glm::uvec3 pos = cell;
+                    pos[s.main_comp] += s.dir < 0 ? 1 : 0;
+                    faces.push_back(unit_face((key >> 1) & 0x7F, key >> 8, pos));
+                }
+            }
+        }
+    }
+    std::ranges::sort(faces);
+    return faces;
+}
+
+// The meshers against the unmerged reference, every covered face must match record by
+// record. The size specialized BinaryMesher must also emit the same stream as the runtime
+// kernel, order and per-direction counts included.
+void check_mesh_kernels(Runner& runner) noexcept
+{
+    using FaceInput = shaders::SolidFlatShader::FaceInput;
+    const BinaryMesher<FaceInput> specialized;
+    const BinaryMesher<FaceInput> runtime{false};
+    const GreedyMesher<FaceInput> greedy;
+    const FlatGenerator generator{globals::ChunkSize, 10};
+    std::vector<std::pair<std::string, ChunkData>> chunks;
+    chunks.emplace_back("hilly", hilly_chunk());
+    chunks.emplace_back("scrambled", make_chunk([](const glm::ivec3& c)
+    {
+        const glm::uvec3 u(c);
+        const uint32_t h = u.x * 73856093u ^ u.y * 19349663u ^ u.z * 83492791u;
+        return static_cast<BlockType>(h % materials.size());
+    }));
+    for (const uint32_t lod : {2u, 4u, 8u})
+    {
+        for (const glm::ivec3 sector : {glm::ivec3(0, 0, 0), glm::ivec3(0, -1, 0)})
+        {
+            if (ChunkData data = generator.generate(sector, lod); !data.empty && !data.solid)
+                chunks.emplace_back(std::format("lod{}_{}", lod, sector.y), std::move(data));
+        }
+    }
+    for (const auto& [name, data] : chunks)
+    {
+        const auto reference = reference_unit_faces(data);
+        LayerMeshes<FaceInput> a;
+        LayerMeshes<FaceInput> b;
+        LayerMeshes<FaceInput> g;
+        specialized.mesh(data, globals::BlockSize, 1, a);
+        runtime.mesh(data, globals::BlockSize, 1, b);
+        greedy.mesh(data, globals::BlockSize, 1, g);
+        runner.check(std::format("mesh/reference/binary/{}", name), reference == unit_faces(a),
+            mismatched(reference, unit_faces(a)));
+        runner.check(std::format("mesh/reference/binary_runtime/{}", name), reference == unit_faces(b),
+            mismatched(reference, unit_faces(b)));
+        runner.check(std::format("mesh/reference/greedy/{}", name), reference == unit_faces(g),
+            mismatched(reference, unit_faces(g)));
+        double mismatches = 0;
+        for (size_t l = 0; l < BlockLayerCount; ++l)
+        {
+            const auto& fa = a[l].faces;
+            const auto& fb = b[l].faces;
+            mismatches += std::abs(static_cast<double>(fa.size()) - static_cast<double>(fb.size()));
+            for (size_t i = 0; i < std::min(fa.size(), fb.size()); ++i)
+                mismatches += fa[i].data != fb[i].data || fa[i].data_ext != fb[i].data_ext;
+            mismatches += a[l].direction_count != b[l].direction_count;
+        }
+        runner.check(std::format("mesh/kernels/{}", name), mismatches == 0, mismatches);
+    }
+}
+
+// Vulkan device without a surface for the GPU checks. A CPU device (lavapipe) is preferred
+// so the results don't depend on the machine's GPU, nothing when there's no 1.3 device.
+[[nodiscard]] std::shared_ptr<vk::Context> create_headless_context() noexcept
+{
+    if (volkInitialize() != VK_SUCCESS)
+        return nullptr;
+    constexpr VkApplicationInfo app_info{
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "choppy_bench",
+        .apiVersion = VK_API_VERSION_1_3
+    };
+    const VkInstanceCreateInfo instance_info{
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &app_info,
+    };
+    VkInstance instance = VK_NULL_HANDLE;
+    if (const VkResult result = vkCreateInstance(&instance_info, nullptr, &instance); result != VK_SUCCESS)
+    {
+        LOGE("Failed to create the headless instance: %s", vk::utils::to_string(result));
+        return nullptr;
+    }
+    volkLoadInstance(instance);
+    uint32_t count = 0;
+    vkEnumeratePhysicalDevices(instance, &count, nullptr);
+    std::vector<VkPhysicalDevice> devices(count);
+    vkEnumeratePhysicalDevices(instance, &count, devices.data());
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    uint32_t queue_family_index = 0;
+    for (VkPhysicalDevice device : devices)
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_3)
+            continue;
+        uint32_t families_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &families_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(families_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &families_count, families.data());
+        const auto family = std::ranges::find_if(families, [](const VkQueueFamilyProperties& f)
+        {
+            return (f.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+        });
+        if (family == families.end())
+            continue;
+        const bool cpu = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+        if (physical_device == VK_NULL_HANDLE || cpu)
+        {
+            physical_device = device;
+            queue_family_index = static_cast<uint32_t>(std::distance(families.begin(), family));
+        }
+        if (cpu)
+            break;
+    }
+    if (physical_device == VK_NULL_HANDLE)
+    {
+        vkDestroyInstance(instance, nullptr);
+        return nullptr;
+    }
+    constexpr float queue_priority = 1.f;
+    const VkDeviceQueueCreateInfo queue_info{
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = queue_family_index,
+        .queueCount = 1,
+        .pQueuePriorities = &queue_priority,
+    };
+    const VkDeviceCreateInfo device_info{
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &queue_info,
+    };
+    VkDevice device = VK_NULL_HANDLE;
+    if (const VkResult result = vkCreateDevice(physical_device, &device_info, nullptr, &device);
+        result != VK_SUCCESS)
+    {
+        LOGE("Failed to create the headless device: %s", vk::utils::to_string(result));
+        vkDestroyInstance(instance, nullptr);
+        return nullptr;
+    }
+    volkLoadDevice(device);
+    auto vk = std::make_shared<vk::Context>();
+    if (!vk->create_from(instance, device, physical_device, queue_family_index))
+        return nullptr;
+    return vk;
+}
+
+// Draws chunk-cull.hlsl emits per layer, as {VertexCount, InstanceCount, FirstVertex, FirstInstance}
+using CullDraws = std::array<std::vector<std::array<uint32_t, 4>>, shaders::ChunkCullShader::CullLayers>;
+
+// CPU copy of the chunk-cull pass: box_visible, visible_faces and the merging of the visible
+// directions into draws, sorted since the shader appends them in any order
+[[nodiscard]] CullDraws reference_cull(const shaders::ChunkCullShader::CullConstants& cull,
+    const std::span<const shaders::ChunkCullShader::ChunkCullInput> chunks) noexcept
+{
+    CullDraws draws;
+    for (uint32_t slot = 0; slot < cull.SlotCount; ++slot)
+    {
+        const auto& chunk = chunks[slot];
+        if (chunk.Valid == 0 || ((cull.Reachable[slot / 128][(slot / 32) % 4] >> (slot % 32)) & 1) == 0)
+            continue;
+        const glm::vec3 bmin{chunk.BoundsMin};
+        const glm::vec3 bmax{chunk.BoundsMax};
+        bool visible = false;
+        uint32_t directions = 0;
+        for (uint32_t eye = 0; eye < cull.EyeCount; ++eye)
+        {
+            bool inside = true;
+            for (uint32_t i = 0; i < 6; ++i)
+            {
+                const glm::vec4 plane = cull.Planes[eye * 6 + i];
+                const glm::vec3 p = bmin + glm::vec3(glm::greaterThanEqual(glm::vec3(plane), glm::vec3(0))) * (bmax - bmin);
+                inside = inside && glm::dot(glm::vec3(plane), p) + plane.w >= 0;
+            }
+            visible = visible || inside;
+            const glm::vec3 lo = bmin - cull.BlockSize;
+            const glm::vec3 hi = bmax + cull.BlockSize;
+            const glm::vec3 e{cull.Eyes[eye]};
+            directions |= uint32_t(e.y >= lo.y) << 0 | uint32_t(e.y <= hi.y) << 1 |
+                uint32_t(e.z >= lo.z) << 2 | uint32_t(e.z <= hi.z) << 3 |
+                uint32_t(e.x <= hi.x) << 4 | uint32_t(e.x >= lo.x) << 5;
+        }
+        if (!visible)
+            continue;
+        for (uint32_t l = 0; l < draws.size(); ++l)
+        {
+            uint32_t first = chunk.FirstFace[l];
+            uint32_t count = 0;
+            for (uint32_t d = 0; d <= 6; ++d)
+            {
+                if (d < 6 && ((directions >> d) & 1) != 0)
+                {
+                    count += chunk.FaceCount[l * 6 + d];
+                    continue;
+                }
+                if (count > 0)
+                    draws[l].push_back({count * 6, 1, first * 6, slot});
+                if (d < 6)
+                    first += count + chunk.FaceCount[l * 6 + d];
+                count = 0;
+            }
+        }
+    }
+    for (auto& layer : draws)
+        std::ranges::sort(layer);
+    return draws;
+}
+
+// Runs chunk-cull.hlsl headless over fixed chunk records and two eyes and compares the draws
+// and the draw counts with reference_cull. Without a Vulkan device it's skipped, or failed
+// when require_gpu is set so a headless CI run can't pass without it.
+void check_chunk_cull(Runner& runner, const bool require_gpu) noexcept
+{
+    using ChunkCull = shaders::ChunkCullShader;
+    const auto vk = create_headless_context();
+    if (!vk)
+    {
+        if (require_gpu)
+            runner.check("cull/gpu_vs_reference", false, 0);
+        else
+            LOGI("%-36s skipped, no Vulkan 1.3 device", "cull/gpu_vs_reference");
+        return;
+    }
+    // a 9x4x9 block of chunks around the eyes, a record per slot like the chunk grid
+    constexpr int32_t side = 9;
+    constexpr int32_t height = 4;
+    constexpr uint32_t slots = side * height * side;
+    static_assert(slots <= ChunkCull::ReachableWords * 128, "a bit per slot");
+    constexpr float chunk_extent = globals::ChunkSize * globals::BlockSize;
+    // at most three runs of visible directions per layer
+    constexpr uint32_t max_draws = slots * 3;
+
+    const glm::mat4 projection = glm::gtc::perspectiveRH_ZO(glm::radians(90.f), 1.f, 0.1f, 1000.f);
+    const glm::mat4 rotation = glm::gtx::eulerAngleYX(0.7f, -0.3f);
+    const std::array eyes{glm::vec3(3.3f, 5.7f, -2.1f), glm::vec3(3.364f, 5.7f, -2.1f)};
+    ChunkCull::CullConstants constants{
+        .EyeCount = static_cast<uint32_t>(eyes.size()),
+        .SlotCount = slots,
+        .MaxDraws = max_draws,
+        .BlockSize = globals::BlockSize,
+    };
+    std::array<Frustum, 2> frustums;
+    for (uint32_t eye = 0; eye < eyes.size(); ++eye)
+    {
+        frustums[eye].update(projection * glm::inverse(glm::gtx::translate(eyes[eye]) * rotation));
+        const auto& planes = frustums[eye].planes();
+        for (size_t i = 0; i < planes.size(); ++i)
+            constants.Planes[eye * planes.size() + i] = glm::vec4(planes[i].normal, planes[i].distance);
+        constants.Eyes[eye] = glm::vec4(eyes[eye], 1);
+    }
+
+    std::mt19937 rng{5};
+    std::uniform_int_distribution<uint32_t> percent(0, 99);
+    std::uniform_int_distribution<uint32_t> faces(1, 40);
+    std::vector<ChunkCull::ChunkCullInput> chunks(slots);
+    for (uint32_t slot = 0; slot < slots; ++slot)
+    {
+        const int32_t i = static_cast<int32_t>(slot);
+        const glm::ivec3 sector = glm::ivec3(i % side, i / (side * side), (i / side) % side) -
+            glm::ivec3(side / 2, height / 2, side / 2);
+        const glm::vec3 bmin = glm::vec3(sector) * chunk_extent;
+        const glm::vec3 bmax = bmin + chunk_extent;
+        auto& chunk = chunks[slot];
+        chunk.BoundsMin = glm::vec4(bmin, 1);
+        chunk.BoundsMax = glm::vec4(bmax, 1);
+        chunk.FirstFace[0] = rng() % (1 << 20);
+        chunk.FirstFace[1] = rng() % (1 << 20);
+        // empty directions split the runs
+        for (auto& count : chunk.FaceCount)
+            count = percent(rng) < 30 ? 0 : faces(rng);
+        // a box within rounding of a plane may go either way on the GPU
+        const bool on_plane = std::ranges::any_of(frustums, [&](const Frustum& frustum)
+        {
+            return std::ranges::any_of(frustum.planes(), [&](const auto& plane)
+            {
+                const glm::vec3 p = bmin + glm::vec3(glm::greaterThanEqual(plane.normal, glm::vec3(0))) * (bmax - bmin);
+                return std::abs(glm::dot(plane.normal, p) + plane.distance) < 1e-2f;
+            });
+        });
+        chunk.Valid = !on_plane && percent(rng) < 85;
+        if (percent(rng) < 85)
+            constants.Reachable[slot / 128][(slot / 32) % 4] |= 1u << (slot % 32);
+    }
+    const CullDraws reference = reference_cull(constants, chunks);
+
+    ChunkCull shader(vk, "Bench");
+    if (!shader.create(1, 1))
+    {
+        runner.check("cull/gpu_vs_reference", false, 0);
+        return;
+    }
+    vk::Buffer constants_buffer(vk, "bench_cull_constants");
+    vk::Buffer chunks_buffer(vk, "bench_cull_chunks");
+    vk::Buffer draws_buffer(vk, "bench_cull_draws");
+    vk::Buffer counts_buffer(vk, "bench_cull_counts");
+    const std::array buffers{
+        std::tuple(&constants_buffer, sizeof(constants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT),
+        std::tuple(&chunks_buffer, chunks.size() * sizeof(ChunkCull::ChunkCullInput), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT),
+        std::tuple(&draws_buffer, ChunkCull::CullLayers * max_draws * sizeof(ChunkCull::DrawCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT),
+        std::tuple(&counts_buffer, ChunkCull::CullLayers * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT),
+    };
+    // the whole buffer as one range, for its mapped pointer
+    std::vector<vk::BufferSuballocation> mapped;
+    for (const auto& [buffer, size, usage] : buffers)
+    {
+        if (!buffer->create(size, usage, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT))
+            break;
+        if (auto sb = buffer->suballoc(size, 16))
+            mapped.push_back(*sb);
+        else
+            break;
+    }
+    const auto free_buffers = [&]
+    {
+        for (size_t i = 0; i < mapped.size(); ++i)
+            std::get<0>(buffers[i])->subfree(mapped[i]);
+    };
+    const auto set = mapped.size() == buffers.size() ? shader.alloc_descriptor(0, 0) : std::nullopt;
+    if (!set)
+    {
+        LOGE("Failed to create the chunk cull bench buffers");
+        free_buffers();
+        runner.check("cull/gpu_vs_reference", false, 0);
+        return;
+    }
+    std::memcpy(mapped[0].ptr, &constants, sizeof(constants));
+    std::memcpy(mapped[1].ptr, chunks.data(), chunks.size() * sizeof(ChunkCull::ChunkCullInput));
+    std::memset(mapped[2].ptr, 0, mapped[2].size);
+    std::memset(mapped[3].ptr, 0, mapped[3].size);
+    shader.write_buffer(*set, 0, constants_buffer.buffer(), 0, VK_WHOLE_SIZE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    shader.write_buffer(*set, 1, chunks_buffer.buffer(), 0, VK_WHOLE_SIZE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    shader.write_buffer(*set, 2, draws_buffer.buffer(), 0, VK_WHOLE_SIZE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    shader.write_buffer(*set, 3, counts_buffer.buffer(), 0, VK_WHOLE_SIZE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    shader.update_descriptors();
+    vk->exec_immediate("bench_chunk_cull", [&](VkCommandBuffer cmd)
+    {
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, shader.pipeline());
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, shader.layout(), 0, 1, &*set, 0, nullptr);
+        vkCmdDispatch(cmd, (slots + ChunkCull::CullThreads - 1) / ChunkCull::CullThreads, 1, 1);
+        const VkMemoryBarrier culled{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        };
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+            0, 1, &culled, 0, nullptr, 0, nullptr);
+    });
+
+    const auto* draws = static_cast<const ChunkCull::DrawCommand*>(mapped[2].ptr);
+    const auto* counts = static_cast<const uint32_t*>(mapped[3].ptr);
+    double mismatches = 0;
+    size_t reference_draws = 0;
+    for (uint32_t l = 0; l < ChunkCull::CullLayers; ++l)
+    {
+        std::vector<std::array<uint32_t, 4>> layer;
+        for (uint32_t i = 0; i < std::min(counts[l], max_draws); ++i)
+        {
+            const auto& d = draws[l * max_draws + i];
+            layer.push_back({d.VertexCount, d.InstanceCount, d.FirstVertex, d.FirstInstance});
+        }
+        std::ranges::sort(layer);
+        mismatches += std::abs(static_cast<double>(counts[l]) - static_cast<double>(reference[l].size()));
+        mismatches += mismatched(layer, reference[l]);
+        reference_draws += reference[l].size();
+    }
+    free_buffers();
+    LOGI("chunk cull: %zu draws expected", reference_draws);
+    runner.check("cull/gpu_vs_reference", reference_draws > 0 && mismatches == 0, mismatches);
+}
+
+void bench_mesh(Runner& runner) noexcept
+{
+    using FaceInput = shaders::SolidFlatShader::FaceInput;
+    const GreedyMesher<FaceInput> greedy;
+    const BinaryMesher<FaceInput> binary;
+    const BinaryMesher<FaceInput> reference{false};
+    const ChunkData flat = make_chunk([](const glm::ivec3& c)
+    {
+        return c.y < 16 ? BlockType::Dirt : BlockType::Air;
+    });
+    const ChunkData hilly = hilly_chunk();
+    const ChunkData checkerboard = make_chunk([](const glm::ivec3& c)
+    {
+        return ((c.x + c.y + c.z) & 1) ? BlockType::Rock : BlockType::Air;
+    });
+    for (const auto& [name, data] : std::to_array<std::pair<const char*, const ChunkData*>>({
+        {"flat", &flat}, {"hilly", &hilly}, {"checkerboard", &checkerboard}}))
+    {
+        const auto greedy_faces = sorted_faces(greedy, *data);
+        const auto binary_faces = sorted_faces(binary, *data);
+        LOGI("mesh/%s: %zu faces, %zu bytes", name, greedy_faces.size(), greedy_faces.size() * sizeof(FaceInput));
+        runner.check(std::format("mesh/{}/binary_vs_greedy", name), greedy_faces == binary_faces,
+            mismatched(greedy_faces, binary_faces));
+        for (const auto& [mesher_name, mesher] : std::to_array<std::pair<const char*, const ChunkMesher<FaceInput>*>>({
+            {"greedy", &greedy}, {"binary", &binary}, {"binary_runtime", &reference}}))
+        {
+            // reused like the pooled outputs of the chunk workers, 0 allocs/op once warm
+            LayerMeshes<FaceInput> meshes;
+            runner.run(std::format("mesh/{}/{}", mesher_name, name), [&]
+            {
+                mesher->mesh(*data, globals::BlockSize, 1, meshes);
+                for (const auto& m : meshes)
+                    runner.sink(m.faces.size());
+            });
+        }
+    }
+}
+
+void bench_physics(Runner& runner) noexcept
+{
+    physics::PhysicsSystem physics;
+    if (!physics.create_system() || !physics.create_shared_box())
+    {
+        LOGE("physics: failed to create the system");
+        return;
+    }
+    const ChunkData hilly = hilly_chunk();
+    const ChunkData checkerboard = make_chunk([](const glm::ivec3& c)
+    {
+        return ((c.x + c.y + c.z) & 1) ? BlockType::Rock : BlockType::Air;
+    });
+    for (const auto& [name, data] : std::to_array<std::pair<const char*, const ChunkData*>>({
+        {"hilly", &hilly}, {"checkerboard", &checkerboard}}))
+    {
+        runner.run(std::format("physics/create_chunk_body_{}", name), [&]
+        {
+            if (auto result = physics.create_chunk_body(globals::ChunkSize, globals::BlockSize, *data, {0, 0, 0}))
+            {
+                auto [body_id, shape] = result.value();
+                physics.remove_body(body_id);
+            }
+        });
+    }
+    physics.destroy_system();
+}
+
+void bench_dda(Runner& runner) noexcept
+{
+    std::mt19937 rng{2};
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::vector<std::pair<glm::vec3, glm::vec3>> rays(256);
+    for (auto& [origin, direction] : rays)
+    {
+        origin = glm::vec3(dist(rng), dist(rng), dist(rng)) * 50.f;
+        direction = glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng)) + glm::vec3(0, 0, 0.01f));
+    }
+    size_t i = 0;
+    runner.run("dda/traverse_10m", [&]
+    {
+        const auto& [origin, direction] = rays[i++ % rays.size()];
+        const auto hits = utils::traverse_3d_dda(origin, direction, glm::vec3(0), 10.f, globals::BlockSize);
+        runner.sink(hits.size());
+    });
+}
+
+void bench_frustum(Runner& runner) noexcept
+{
+    Frustum frustum;
+    const glm::mat4 projection = glm::gtc::perspectiveRH_ZO(glm::radians(90.f), 1.f, 0.1f, 1000.f);
+    const glm::mat4 view = glm::inverse(glm::gtx::translate(glm::vec3(0, 8, 0)));
+    frustum.update(projection * view);
+    constexpr int32_t rings = globals::MaxChunkRings;
+    constexpr float chunk_extent = globals::ChunkSize * globals::BlockSize;
+    std::vector<AABB> boxes;
+    for (int32_t y = -rings; y <= rings; ++y)
+        for (int32_t z = -rings; z <= rings; ++z)
+            for (int32_t x = -rings; x <= rings; ++x)
+                boxes.push_back({glm::vec3(x, y, z) * chunk_extent, glm::vec3(x + 1, y + 1, z + 1) * chunk_extent});
+    runner.run(std::format("frustum/is_box_visible_x{}", boxes.size()), [&]
+    {
+        uint64_t visible = 0;
+        for (const auto& box : boxes)
+            visible += frustum.is_box_visible(box);
+        runner.sink(visible);
+    });
+}
+
+void bench_messages(Runner& runner) noexcept
+{
+    const messages::BlockActionMessage action{
+        .action = messages::BlockActionMessage::ActionType::Break,
+        .world_cell = {12, -3, 40},
+    };
+    runner.run("messages/block_action_roundtrip", [&]
+    {
+        const auto buffer = action.serialize();
+        if (const auto message = messages::BlockActionMessage::deserialize(buffer))
+            runner.sink(message->world_cell.x);
+    });
+    messages::ChunkDataMessage chunks{.message_direction = messages::MessageDirection::Response};
+    std::mt19937 rng{3};
+    for (int32_t i = 0; i < 128; ++i)
+    {
+        chunks.sectors.emplace_back(i % 8, i / 64, (i / 8) % 8);
+        chunks.sizes.push_back(64);
+        for (int32_t j = 0; j < 64; ++j)
+            chunks.data.push_back(static_cast<uint8_t>(rng()));
+    }
+    runner.run("messages/chunk_data_roundtrip_x128", [&]
+    {
+        const auto buffer = chunks.serialize();
+        if (const auto message = messages::ChunkDataMessage::deserialize(buffer))
+            runner.sink(message->data.size());
+    });
+}
+
+// Runs all the benchmarks matching the filter, returns the process exit code:
+// 1 when a check failed, 2 on bad arguments.
+// Arguments: [--filter <text>] [--min-time <ms>] [--json <path>] [--require-gpu]
+int run(const std::vector<std::string>& args) noexcept
+{
+    std::string filter;
+    std::string json_path;
+    std::chrono::milliseconds min_time{200};
+    bool require_gpu = false;
+    for (size_t i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "--require-gpu")
+            require_gpu = true;
+        else if (i + 1 == args.size())
+            break;
+        else if (args[i] == "--filter")
+            filter = args[++i];
+        else if (args[i] == "--json")
+            json_path = args[++i];
+        else if (args[i] == "--min-time")
+        {
+            const std::string& value = args[++i];
+            int32_t ms = 0;
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), ms);
+            if (error != std::errc{} || end != value.data() + value.size() || ms < 0)
+            {
+                LOGE("invalid --min-time %s, expected milliseconds", value.c_str());
+                LOGE("usage: ce_bench [--filter <text>] [--min-time <ms>] [--json <path>] [--require-gpu]");
+                return 2;
+            }
+            min_time = std::chrono::milliseconds(ms);
+        }
+    }
+    LOGI("noise backend: %s", BatchNoise::backend());
+    Runner runner(filter, min_time);
+    check_noise(runner);
+    check_peek(runner);
+    check_mesh_kernels(runner);
+    check_chunk_cull(runner, require_gpu);
+    bench_noise(runner);
+    bench_generate(runner);
+    bench_mesh(runner);
+    bench_physics(runner);
+    bench_dda(runner);
+    bench_frustum(runner);
+    bench_messages(runner);
+    if (!json_path.empty())
+    {
+        std::ofstream file(json_path);
+        if (!file.is_open())
+        {
+            LOGE("failed to open %s", json_path.c_str());
+            return 1;
+        }
+        file << runner.to_json().dump(2);
+    }
+    return runner.passed() ? 0 : 1;
+}
+}
@@ -0,0 +1,146 @@
+module;
+
+#include <array>
+#include <vector>
+#include <format>
+#include <memory>
+#include <optional>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+#include <glm/gtx/compatibility.hpp>
+
+export module ce.shaders.chunkcull;
+import ce.vk;
+import ce.vk.shader;
+import glm;
+
+export namespace ce::shaders
+{
+class ChunkCullShader final : public vk::ShaderModule
+{
+public:
+    #include "chunk-cull.h"
+private:
+    bool create_layout()
+    {
+        constexpr std::array set_bindings{
+            // uniforms (type.CullConstants)
+            VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr
+            },
+            // chunk records (type.ChunkCullInput)
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr
+            },
+            // draw commands (type.DrawCommand)
+            VkDescriptorSetLayoutBinding{
+                .binding = 2,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr
+            },
+            // draw counts, one per layer
+            VkDescriptorSetLayoutBinding{
+                .binding = 3,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr
+            },
+        };
+        const VkDescriptorSetLayoutCreateInfo set_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .flags = 0,
+            .bindingCount = static_cast<uint32_t>(set_bindings.size()),
+            .pBindings = set_bindings.data()
+        };
+        m_set_layouts.resize(1);
+        if (const VkResult result = vkCreateDescriptorSetLayout(m_vk.device(), &set_info,
+            nullptr, &m_set_layouts[0]); result != VK_SUCCESS)
+        {
+            return false;
+        }
+        m_vk.debug_name(std::format("{}-CullSetLayout", m_name), m_set_layouts[0]);
+        // Pipeline layout
+        const VkPipelineLayoutCreateInfo layout_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .flags = 0,
+            .setLayoutCount = static_cast<uint32_t>(m_set_layouts.size()),
+            .pSetLayouts = m_set_layouts.data(),
+        };
+        if (const VkResult result = vkCreatePipelineLayout(m_vk.device(), &layout_info, nullptr, &m_layout);
+            result != VK_SUCCESS)
+        {
+            return false;
+        }
+        m_vk.debug_name(std::format("{}-PipelineLayout", m_name), m_layout);
+        return true;
+    }
+    bool create_pipeline() noexcept
+    {
+        const VkComputePipelineCreateInfo pipeline_info{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = VkPipelineShaderStageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = m_module_cs,
+                .pName = "CSMain",
+                .pSpecializationInfo = nullptr
+            },
+            .layout = m_layout,
+        };
+        if (const VkResult result = vkCreateComputePipelines(m_vk.device(), VK_NULL_HANDLE,
+            1, &pipeline_info, nullptr, &m_pipeline); result != VK_SUCCESS)
+        {
+            return false;
+        }
+        return true;
+    }
+    bool create_pools(const uint32_t pools_count, const uint32_t cull_sets) noexcept
+    {
+        m_descriptor_pools.resize(pools_count);
+        for (size_t i = 0; i < pools_count; i++)
+        {
+            const std::array descr_pool_sizes{
+                VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, cull_sets },
+                VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cull_sets * 3 },
+            };
+            const VkDescriptorPoolCreateInfo descr_pool_info{
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                .maxSets = cull_sets,
+                .poolSizeCount = static_cast<uint32_t>(descr_pool_sizes.size()),
+                .pPoolSizes = descr_pool_sizes.data()
+            };
+            if (const VkResult result = vkCreateDescriptorPool(m_vk.device(),
+                &descr_pool_info, nullptr, &m_descriptor_pools[i]); result != VK_SUCCESS)
+            {
+                return false;
+            }
+            m_vk.debug_name(std::format("{}_descr_pool[{}]", m_name, i), m_descriptor_pools[i]);
+        }
+        return true;
+    }
+public:
+    explicit ChunkCullShader(const std::shared_ptr<vk::Context>& vk, const std::string_view name)
+        : ShaderModule(vk, std::format("ChunkCull-{}", name)) { }
+    ~ChunkCullShader() noexcept override = default;
+    bool create(const uint32_t pools_count, const uint32_t cull_sets) noexcept
+    {
+        if (!load_compute_from_file("assets/shaders/chunk-cull-cs.spv") ||
+            !create_layout() || !create_pipeline() || !create_pools(pools_count, cull_sets))
+        {
+            return false;
+        }
+        return true;
+    }
+};
+}
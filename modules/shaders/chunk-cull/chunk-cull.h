@@ -0,0 +1,44 @@
+#pragma once
+#include "../hlsl_common.h"
+
+static const uint CullThreads = 64;
+static const uint CullLayers = 2;
+// uint4 words of one bit per grid slot, room for 768 slots
+static const uint ReachableWords = 6;
+
+struct alignas(16) CullConstants
+{
+    // 6 frustum planes per eye, xyz = normal, w = distance
+    float4 Planes[12];
+    float4 Eyes[2];
+    uint EyeCount;
+    uint SlotCount;
+    // draw commands each layer has room for
+    uint MaxDraws;
+    // faces boxes are padded by a block, see visible_faces
+    float BlockSize;
+    // slots the cave culling walk got to from the camera, bit slot % 32 of
+    // Reachable[slot / 128][(slot / 32) % 4]
+    uint4 Reachable[ReachableWords];
+};
+
+// One record per chunk grid slot, only rewritten when the chunk in it changes. The slot is
+// also the draw's firstInstance, which picks the chunk's PerObjectBuffer in solid-flat.
+struct alignas(16) ChunkCullInput
+{
+    float4 BoundsMin;
+    float4 BoundsMax;
+    // first face record per layer in the face buffer
+    uint FirstFace[2];
+    uint Valid;
+    // faces per layer and direction, in MeshSlices order
+    uint FaceCount[12];
+};
+
+struct DrawCommand
+{
+    uint VertexCount;
+    uint InstanceCount;
+    uint FirstVertex;
+    uint FirstInstance;
+};
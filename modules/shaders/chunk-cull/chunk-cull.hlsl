@@ -0,0 +1,96 @@
+#include "chunk-cull.h"
+
+[[vk::binding(0, 0)]] cbuffer CullConstants { CullConstants Cull; };
+[[vk::binding(1, 0)]] StructuredBuffer<ChunkCullInput> Chunks;
+// per layer regions of MaxDraws entries
+[[vk::binding(2, 0)]] RWStructuredBuffer<DrawCommand> Draws;
+// zeroed before the dispatch, read back by vkCmdDrawIndirectCount
+[[vk::binding(3, 0)]] RWStructuredBuffer<uint> DrawCounts;
+
+bool box_visible(float3 bmin, float3 bmax, uint eye)
+{
+    for (uint i = 0; i < 6; i++)
+    {
+        const float4 plane = Cull.Planes[eye * 6 + i];
+        // corner farthest along the plane normal
+        const float3 p = lerp(bmin, bmax, step(0.0, plane.xyz));
+        if (dot(plane.xyz, p) + plane.w < 0.0)
+            return false;
+    }
+    return true;
+}
+
+// Face directions of the box that can be seen from the eye, as Block::Mask bits
+// (U, D, F, B, L, R). A face on a box plane counts as visible from that plane, so a box
+// containing the eye gets all six.
+uint visible_faces(float3 bmin, float3 bmax, float3 eye)
+{
+    uint mask = 0;
+    mask |= uint(eye.y >= bmin.y) << 0; // U +y
+    mask |= uint(eye.y <= bmax.y) << 1; // D -y
+    mask |= uint(eye.z >= bmin.z) << 2; // F +z
+    mask |= uint(eye.z <= bmax.z) << 3; // B -z
+    mask |= uint(eye.x <= bmax.x) << 4; // L -x
+    mask |= uint(eye.x >= bmin.x) << 5; // R +x
+    return mask;
+}
+
+[numthreads(CullThreads, 1, 1)]
+void CSMain(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= Cull.SlotCount)
+        return;
+    const ChunkCullInput chunk = Chunks[id.x];
+    if (chunk.Valid == 0)
+        return;
+    // hidden behind opaque blocks
+    if (((Cull.Reachable[id.x / 128][(id.x / 32) % 4] >> (id.x % 32)) & 1) == 0)
+        return;
+
+    const float3 bmin = chunk.BoundsMin.xyz;
+    const float3 bmax = chunk.BoundsMax.xyz;
+    bool visible = false;
+    uint directions = 0;
+    for (uint eye = 0; eye < Cull.EyeCount; eye++)
+    {
+        visible = visible || box_visible(bmin, bmax, eye);
+        // padded by a block to keep faces on the box planes and the lowered water surface
+        directions |= visible_faces(bmin - Cull.BlockSize, bmax + Cull.BlockSize, Cull.Eyes[eye].xyz);
+    }
+    if (!visible)
+        return;
+
+    for (uint l = 0; l < CullLayers; l++)
+    {
+        // the vertex shader reads face record VertexID / 6
+        uint first = chunk.FirstFace[l];
+        uint count = 0;
+        // visible directions next to each other share a draw
+        for (uint d = 0; d <= 6; d++)
+        {
+            if (d < 6 && ((directions >> d) & 1) != 0)
+            {
+                count += chunk.FaceCount[l * 6 + d];
+                continue;
+            }
+            if (count > 0)
+            {
+                uint index;
+                InterlockedAdd(DrawCounts[l], 1, index);
+                if (index < Cull.MaxDraws)
+                {
+                    DrawCommand draw;
+                    draw.VertexCount = count * 6;
+                    draw.InstanceCount = 1;
+                    draw.FirstVertex = first * 6;
+                    // the vertex shader reads the chunk's object at BaseInstance
+                    draw.FirstInstance = id.x;
+                    Draws[l * Cull.MaxDraws + index] = draw;
+                }
+            }
+            if (d < 6)
+                first += count + chunk.FaceCount[l * 6 + d];
+            count = 0;
+        }
+    }
+}
@@ -30,6 +30,10 @@ typedef glm::mat<4, 2, int, glm::highp>		    int4x2;			//!< \brief integer matri
 typedef glm::mat<4, 3, int, glm::highp>		    int4x3;			//!< \brief integer matrix with 4 x 3 components. (From GLM_GTX_compatibility extension)
 typedef glm::mat<4, 4, int, glm::highp>		    int4x4;			//!< \brief integer matrix with 4 x 4 components. (From GLM_GTX_compatibility extension)
 
+typedef glm::vec<2, unsigned int, glm::highp>	uint2;			//!< \brief unsigned integer vector with 2 components.
+typedef glm::vec<3, unsigned int, glm::highp>	uint3;			//!< \brief unsigned integer vector with 3 components.
+typedef glm::vec<4, unsigned int, glm::highp>	uint4;			//!< \brief unsigned integer vector with 4 components.
+
 typedef float						            float1;			//!< \brief single-qualifier floating-point vector with 1 component. (From GLM_GTX_compatibility extension)
 typedef glm::vec<2, float, glm::highp>		    float2;			//!< \brief single-qualifier floating-point vector with 2 components. (From GLM_GTX_compatibility extension)
 typedef glm::vec<3, float, glm::highp>		    float3;			//!< \brief single-qualifier floating-point vector with 3 components. (From GLM_GTX_compatibility extension)
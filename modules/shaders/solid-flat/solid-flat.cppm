@@ -48,6 +48,14 @@ private:
                 .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
                 .pImmutableSamplers = nullptr
             },
+            // face records (type.FaceInput)
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+                .pImmutableSamplers = nullptr
+            },
         };
         const std::array set_info{
             // Per frame set
@@ -61,7 +69,7 @@ private:
             VkDescriptorSetLayoutCreateInfo{
                 .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
                 .flags = 0,
-                .bindingCount = 1,
+                .bindingCount = 2,
                 .pBindings = set_bindings.data() + 2
             },
         };
@@ -94,8 +102,20 @@ private:
         return true;
     }
     bool create_pipeline(VkRenderPass renderpass, const VkSampleCountFlagBits sample_count,
-        const bool enable_blending, const bool double_sided) noexcept
+        const bool enable_blending, const bool double_sided, const float y_offset) noexcept
     {
+        // LayerYOffset
+        constexpr VkSpecializationMapEntry y_offset_entry{
+            .constantID = 0,
+            .offset = 0,
+            .size = sizeof(float),
+        };
+        const VkSpecializationInfo vs_specialization{
+            .mapEntryCount = 1,
+            .pMapEntries = &y_offset_entry,
+            .dataSize = sizeof(float),
+            .pData = &y_offset,
+        };
         // Pipeline
         const std::array stages{
             VkPipelineShaderStageCreateInfo{
@@ -103,7 +123,7 @@ private:
                 .stage = VK_SHADER_STAGE_VERTEX_BIT,
                 .module = m_module_vs,
                 .pName = "VSMain",
-                .pSpecializationInfo = nullptr
+                .pSpecializationInfo = &vs_specialization
             },
             VkPipelineShaderStageCreateInfo{
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -113,39 +133,9 @@ private:
                 .pSpecializationInfo = nullptr
             },
         };
-        constexpr std::array input_binding{
-            VkVertexInputBindingDescription{
-                .binding = 0,
-                .stride = sizeof(VertexInput),
-                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
-            }
-        };
-        const std::array input_attribute{
-            VkVertexInputAttributeDescription{
-                .location = 0,
-                .binding = 0,
-                .format = VK_FORMAT_R32_UINT,
-                .offset = offsetof(VertexInput, data)
-            },
-            VkVertexInputAttributeDescription{
-                .location = 1,
-                .binding = 0,
-                .format = VK_FORMAT_R32_UINT,
-                .offset = offsetof(VertexInput, data_ext)
-            },
-            // VkVertexInputAttributeDescription{
-            //     .location = 1,
-            //     .binding = 0,
-            //     .format = VK_FORMAT_R32G32_SFLOAT,
-            //     .offset = offsetof(VertexInput, uvs)
-            // },
-        };
-        const VkPipelineVertexInputStateCreateInfo input{
+        // vertices are pulled from the Faces storage buffer
+        constexpr VkPipelineVertexInputStateCreateInfo input{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            .vertexBindingDescriptionCount = static_cast<uint32_t>(input_binding.size()),
-            .pVertexBindingDescriptions = input_binding.data(),
-            .vertexAttributeDescriptionCount = static_cast<uint32_t>(input_attribute.size()),
-            .pVertexAttributeDescriptions = input_attribute.data()
         };
         constexpr VkPipelineInputAssemblyStateCreateInfo assembly{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -239,7 +229,7 @@ private:
             const std::array descr_pool_sizes{
                 VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame_sets },
                 VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frame_sets },
-                VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, object_sets },
+                VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, object_sets * 2 },
             };
             const VkDescriptorPoolCreateInfo descr_pool_info{
                 .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
@@ -261,10 +251,11 @@ public:
         : ShaderModule(vk, std::format("SolidFlat-{}", name)) { }
     ~SolidFlatShader() noexcept override = default;
     bool create(VkRenderPass renderpass, const uint32_t pools_count, const VkSampleCountFlagBits sample_count,
-        const uint32_t frame_sets, const uint32_t object_sets, const bool enable_blending, const bool double_sided) noexcept
+        const uint32_t frame_sets, const uint32_t object_sets, const bool enable_blending, const bool double_sided,
+        const float y_offset = 0.f) noexcept
     {
         if (!load_from_file("assets/shaders/solid-flat-vs.spv", "assets/shaders/solid-flat-ps.spv") ||
-            !create_layout() || !create_pipeline(renderpass, sample_count, enable_blending, double_sided) ||
+            !create_layout() || !create_pipeline(renderpass, sample_count, enable_blending, double_sided, y_offset) ||
             !create_pools(pools_count, frame_sets, object_sets))
         {
             return false;
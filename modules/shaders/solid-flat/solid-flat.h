@@ -10,19 +10,20 @@ struct alignas(64) PerFrameConstants
     float fogEnd;
 };
 
+// One per chunk grid slot, written when the chunk in it changes and picked by firstInstance
 struct alignas(16) PerObjectBuffer
 {
     float4x4 ObjectTransform;
-    float y_offset;
     uint lod;
 };
 
-struct VertexInput
+// One record per quad, expanded to 6 vertices in VSMain from SV_VertexID
+struct FaceInput
 {
-    // Layout: [1b v | 1b u | 12b layer | 6b z | 6b y | 6b x]
-    [[vk::location(0)]] uint data SEM(DATA);
-    // Layout: [27b free | 4b occlusion | 3b face]
-    [[vk::location(1)]] uint data_ext SEM(DATA_EXT);
+    // Layout: [2b free | 6b height | 6b width | 6b z | 6b y | 6b x]
+    uint data;
+    // Layout: [13b free | 12b layer | 4b occlusion | 3b face]
+    uint data_ext;
 };
 
 struct PixelInput
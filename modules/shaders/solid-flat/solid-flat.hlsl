@@ -2,29 +2,52 @@
 
 [[vk::binding(0, 0)]] cbuffer PerFrameConstants { PerFrameConstants Frame; };
 [[vk::binding(0, 1)]] StructuredBuffer<PerObjectBuffer> ObjectsData;
+[[vk::binding(1, 1)]] StructuredBuffer<FaceInput> Faces;
+// set per pipeline, the transparent layer sits a bit lower
+[[vk::constant_id(0)]] const float LayerYOffset = 0.0;
 
-PixelInput VSMain(VertexInput input,
+// Quad corners as (u, v) unit offsets: A, B, C, D
+static const float2 CornerOffset[4] = { float2(0, 0), float2(0, 1), float2(1, 1), float2(1, 0) };
+// Triangle corners for the two windings, see FaceReversed
+static const uint CornerIndex[2][6] = { { 0, 1, 2, 0, 2, 3 }, { 0, 2, 1, 0, 3, 2 } };
+// Per face (U, D, F, B, L, R) axes of the quad and winding
+static const float3 FaceU[6] = {
+    float3(1, 0, 0), float3(1, 0, 0), float3(1, 0, 0), float3(1, 0, 0), float3(0, 0, 1), float3(0, 0, 1) };
+static const float3 FaceV[6] = {
+    float3(0, 0, 1), float3(0, 0, 1), float3(0, 1, 0), float3(0, 1, 0), float3(0, 1, 0), float3(0, 1, 0) };
+static const uint FaceReversed[6] = { 1, 0, 0, 1, 0, 1 };
+
+PixelInput VSMain(uint VertexID : SV_VertexID,
     uint ViewIndex : SV_ViewID,
-    [[vk::builtin("DrawIndex")]] uint drawIndex : SV_InstanceID)
+    [[vk::builtin("BaseInstance")]] uint baseInstance : BASE_INSTANCE)
 {
+    const PerObjectBuffer chunk = ObjectsData[baseInstance];
+    // firstVertex of the draw is the first face record * 6
+    const FaceInput input = Faces[VertexID / 6];
     // Unpack the 32-bit integer
-    // Layout: [1b v | 1b u | 12b layer | 6b z | 6b y | 6b x]
+    // Layout: [2b free | 6b height | 6b width | 6b z | 6b y | 6b x]
     float x = float(input.data & 0x3F);
-    float y = float((input.data >> 6) & 0x3F) + ObjectsData[drawIndex].y_offset;
+    float y = float((input.data >> 6) & 0x3F) + LayerYOffset;
     float z = float((input.data >> 12) & 0x3F);
-    float layer = float((input.data >> 18) & 0xFFF);
-    float u = float((input.data >> 30) & 0x1);
-    float v = float((input.data >> 31) & 0x1);
-    // Layout: [27b free | 4b occlusion | 3b face]
+    float width = float((input.data >> 18) & 0x3F);
+    float height = float((input.data >> 24) & 0x3F);
+    // Layout: [13b free | 12b layer | 4b occlusion | 3b face]
     int face = input.data_ext & 0x07;
     int occ = (input.data_ext >> 3) & 0x0F;
+    float layer = float((input.data_ext >> 7) & 0xFFF);
+
+    // Texture v runs opposite to the quad v axis
+    const float2 corner = CornerOffset[CornerIndex[FaceReversed[face]][VertexID % 6]] * float2(width, height);
+    const float u = corner.x;
+    const float v = height - corner.y;
+    const float3 Corner = float3(x, y, z) + FaceU[face] * corner.x + FaceV[face] * corner.y;
 
-    const float4x4 WorldViewProjection = mul(ObjectsData[drawIndex].ObjectTransform, Frame.ViewProjection[ViewIndex]);
-    const float3 Position = float3(x, y, z) * 0.5;
+    const float4x4 WorldViewProjection = mul(chunk.ObjectTransform, Frame.ViewProjection[ViewIndex]);
+    const float3 Position = Corner * 0.5;
 
     PixelInput output;
     output.position = mul(float4(Position, 1.0), WorldViewProjection);
-    output.uvs = float2(u, v) * float(ObjectsData[drawIndex].lod);
+    output.uvs = float2(u, v) * float(chunk.lod);
     output.layer = layer;
     output.face = face;
     output.occ = occ;
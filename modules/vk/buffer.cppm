@@ -72,6 +72,17 @@ struct BufferSuballocation
     void* ptr = nullptr;
 };
 
+// Usage of the virtual block behind suballoc
+struct BufferStats
+{
+    VkDeviceSize used = 0;
+    VkDeviceSize free = 0;
+    VkDeviceSize largest_free = 0;
+    uint32_t allocations = 0;
+    // share of the free space outside the largest free range, 0 when it's all in one piece
+    float fragmentation = 0;
+};
+
 class Buffer
 {
 public:
@@ -130,7 +141,7 @@ public:
         return true;
     }
     [[nodiscard]] std::optional<BufferSuballocation> suballoc(const VkDeviceSize size,
-        const VkDeviceSize alignment) noexcept
+        const VkDeviceSize alignment, const VmaVirtualAllocationCreateFlags flags = 0) noexcept
     {
         if (!m_virtual_block)
         {
@@ -142,7 +153,7 @@ public:
                 return std::nullopt;
             }
         }
-        const VmaVirtualAllocationCreateInfo alloc_create_info = {.size = size, .alignment = alignment};
+        const VmaVirtualAllocationCreateInfo alloc_create_info = {.size = size, .alignment = alignment, .flags = flags};
         VmaVirtualAllocation alloc;
         VkDeviceSize offset;
         if (const VkResult result = vmaVirtualAllocate(m_virtual_block, &alloc_create_info, &alloc, &offset);
@@ -154,6 +165,22 @@ public:
         TracyAllocN(static_cast<uint8_t*>(m_allocation_info.pMappedData) + offset, size, m_name.c_str());
         return BufferSuballocation{alloc, offset, size, static_cast<uint8_t*>(m_allocation_info.pMappedData) + offset};
     }
+    [[nodiscard]] BufferStats stats() const noexcept
+    {
+        if (!m_virtual_block)
+            return {.free = m_size, .largest_free = m_size};
+        VmaDetailedStatistics stats{};
+        vmaCalculateVirtualBlockStatistics(m_virtual_block, &stats);
+        const VkDeviceSize used = stats.statistics.allocationBytes;
+        const VkDeviceSize free = stats.statistics.blockBytes - used;
+        return {
+            .used = used,
+            .free = free,
+            .largest_free = stats.unusedRangeSizeMax,
+            .allocations = stats.statistics.allocationCount,
+            .fragmentation = free > 0 ? 1.f - static_cast<float>(stats.unusedRangeSizeMax) / free : 0.f,
+        };
+    }
     void subfree(const BufferSuballocation& suballoc) noexcept
     {
         if (m_virtual_block)
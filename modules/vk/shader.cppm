@@ -40,6 +40,7 @@ protected:
     std::string m_name;
     VkShaderModule m_module_vs = VK_NULL_HANDLE;
     VkShaderModule m_module_ps = VK_NULL_HANDLE;
+    VkShaderModule m_module_cs = VK_NULL_HANDLE;
     VkPipelineLayout m_layout = VK_NULL_HANDLE;
     VkPipeline m_pipeline = VK_NULL_HANDLE;
     std::vector<VkDescriptorSetLayout> m_set_layouts;
@@ -102,6 +103,19 @@ protected:
         }
         return true;
     }
+    bool load_compute_from_file(const std::string& cs_path) noexcept
+    {
+        if (auto cs = create_shader_module(cs_path))
+        {
+            m_module_cs = cs.value();
+        }
+        else
+        {
+            LOGE("Failed loading shader %s", m_name.c_str());
+            return false;
+        }
+        return true;
+    }
 public:
     [[nodiscard]] VkPipeline pipeline() const noexcept { return m_pipeline; }
     [[nodiscard]] VkPipelineLayout layout() const noexcept { return m_layout; }
@@ -112,8 +126,11 @@ public:
             vkDestroyShaderModule(m_vk.device(), m_module_vs, nullptr);
         if (m_module_ps != VK_NULL_HANDLE)
             vkDestroyShaderModule(m_vk.device(), m_module_ps, nullptr);
+        if (m_module_cs != VK_NULL_HANDLE)
+            vkDestroyShaderModule(m_vk.device(), m_module_cs, nullptr);
         m_module_vs = VK_NULL_HANDLE;
         m_module_ps = VK_NULL_HANDLE;
+        m_module_cs = VK_NULL_HANDLE;
     }
     bool reset_descriptors(const uint32_t pool_index) const noexcept
     {
@@ -69,6 +69,8 @@ class Context final
     VmaAllocationInfo m_depth_allocation_info = {};
 
     bool m_msaa_enabled = true;
+    // vkCmdDrawIndirectCountKHR is usable, both device paths enable the extension when present
+    bool m_draw_indirect_count = false;
 
     std::vector<VkSemaphore> m_wait_swapchain;
     std::vector<VkSemaphore> m_wait_render;
@@ -97,6 +99,16 @@ class Context final
         vkGetPhysicalDeviceProperties2(m_physical_device, &physical_device_properties);
         m_physical_device_limits = physical_device_properties.properties.limits;
         LOGI("Vulkan device: %s", physical_device_properties.properties.deviceName);
+        m_draw_indirect_count = [this] {
+            uint32_t count = 0;
+            vkEnumerateDeviceExtensionProperties(m_physical_device, nullptr, &count, nullptr);
+            std::vector props(count, VkExtensionProperties{});
+            vkEnumerateDeviceExtensionProperties(m_physical_device, nullptr, &count, props.data());
+            return std::ranges::any_of(props, [](const VkExtensionProperties& v)
+            {
+                return std::string_view(v.extensionName) == VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+            });
+        }();
 
         const VkDeviceQueueInfo2 get_queue_info{
             .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_INFO_2,
@@ -170,6 +182,7 @@ public:
     [[nodiscard]] VkSwapchainKHR swapchain() const noexcept { return m_swapchain; }
     [[nodiscard]] VkSampleCountFlagBits samples_count() const noexcept { return m_msaa_enabled ? VK_SAMPLE_COUNT_4_BIT : VK_SAMPLE_COUNT_1_BIT; }
     [[nodiscard]] TracyVkCtx tracy() const noexcept { return tracy_ctx; }
+    [[nodiscard]] bool draw_indirect_count() const noexcept { return m_draw_indirect_count; }
     [[nodiscard]] uint32_t swapchain_count() const noexcept
     {
         return static_cast<uint32_t>(m_color_swapchain_images.size());
@@ -373,6 +386,7 @@ public:
             VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME,
             VK_EXT_MULTISAMPLED_RENDER_TO_SINGLE_SAMPLED_EXTENSION_NAME,
             VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME,
+            VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
         };
         for (const char* e : vk_device_optional_extensions)
         {
@@ -390,9 +404,13 @@ public:
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
             //.pNext = &bda_feature,
         };
+        VkPhysicalDeviceShaderDrawParametersFeatures draw_parameters_feature{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES,
+            .pNext = &timeline_features,
+        };
         VkPhysicalDeviceRobustness2FeaturesEXT robustness_feature{
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ROBUSTNESS_2_FEATURES_EXT,
-            .pNext = &timeline_features,
+            .pNext = &draw_parameters_feature,
         };
         VkPhysicalDeviceMultiviewFeatures multiview_feature{
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES,
@@ -432,6 +450,17 @@ public:
             LOGE("Failed to find a timeline semaphore feature");
             return false;
         }
+        // chunk draws select their object with firstInstance, read back as BaseInstance
+        if (!supported_physical_device_features.features.drawIndirectFirstInstance)
+        {
+            LOGE("Failed to find a draw indirect first instance feature");
+            return false;
+        }
+        if (!draw_parameters_feature.shaderDrawParameters)
+        {
+            LOGE("Failed to find a shader draw parameters feature");
+            return false;
+        }
         // disable not needed features
         robustness_feature.robustBufferAccess2 = false;
         robustness_feature.robustImageAccess2 = false;
@@ -443,6 +472,7 @@ public:
             .pNext = &imageless_feature,
             .features = {
                 .multiDrawIndirect = true,
+                .drawIndirectFirstInstance = true,
                 .fillModeNonSolid = true,
                 .wideLines = true,
             }
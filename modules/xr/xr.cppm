@@ -681,6 +681,7 @@ public:
             VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME,
             VK_EXT_MULTISAMPLED_RENDER_TO_SINGLE_SAMPLED_EXTENSION_NAME,
             VK_EXT_LINE_RASTERIZATION_EXTENSION_NAME,
+            VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
         };
         for (const char* e : vk_device_optional_extensions)
         {
@@ -765,6 +766,12 @@ public:
             LOGE("Failed to find a timeline semaphore feature");
             return false;
         }
+        // chunk draws select their object with firstInstance, read back as BaseInstance
+        if (!supported_physical_device_features.features.drawIndirectFirstInstance)
+        {
+            LOGE("Failed to find a draw indirect first instance feature");
+            return false;
+        }
         // disable not needed features
         robustness_feature.robustBufferAccess2 = false;
         robustness_feature.robustImageAccess2 = false;
@@ -787,6 +794,7 @@ public:
                 reinterpret_cast<void*>(&imageless_feature) : reinterpret_cast<void*>(&enable_features11),
             .features = {
                 .multiDrawIndirect = supported_physical_device_features.features.multiDrawIndirect,
+                .drawIndirectFirstInstance = true,
                 .fillModeNonSolid = supported_physical_device_features.features.fillModeNonSolid,
                 .wideLines = supported_physical_device_features.features.wideLines,
             }
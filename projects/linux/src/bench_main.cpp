@@ -0,0 +1,120 @@
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+import ce.app.bench;
+
+// Count every heap allocation so the benchmarks can report bytes per op. All the replaceable
+// forms go through here, the library defaults of the aligned ones wouldn't be counted.
+namespace
+{
+void* counted_alloc(const std::size_t count, const std::size_t alignment) noexcept
+{
+    ce::app::bench::allocated_bytes.fetch_add(count, std::memory_order_relaxed);
+    ce::app::bench::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t size = count == 0 ? 1 : count;
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        return malloc(size);
+    // aligned_alloc wants a multiple of the alignment
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+void* counted_alloc_or_throw(const std::size_t count, const std::size_t alignment)
+{
+    if (const auto ptr = counted_alloc(count, alignment))
+        return ptr;
+    throw std::bad_alloc();
+}
+}
+
+void* operator new(const std::size_t count)
+{
+    return counted_alloc_or_throw(count, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void* operator new[](const std::size_t count)
+{
+    return counted_alloc_or_throw(count, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void* operator new(const std::size_t count, const std::align_val_t alignment)
+{
+    return counted_alloc_or_throw(count, static_cast<std::size_t>(alignment));
+}
+void* operator new[](const std::size_t count, const std::align_val_t alignment)
+{
+    return counted_alloc_or_throw(count, static_cast<std::size_t>(alignment));
+}
+void* operator new(const std::size_t count, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(count, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void* operator new[](const std::size_t count, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(count, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void* operator new(const std::size_t count, const std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(count, static_cast<std::size_t>(alignment));
+}
+void* operator new[](const std::size_t count, const std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(count, static_cast<std::size_t>(alignment));
+}
+
+// malloc and aligned_alloc memory both go back with free
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    free(ptr);
+}
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    free(ptr);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+int main(const int argc, const char** argv)
+{
+    std::vector<std::string> args;
+    args.reserve(argc);
+    for (int i = 0; i < argc; ++i)
+        args.emplace_back(argv[i]);
+    return ce::app::bench::run(args);
+}